@@ -0,0 +1,249 @@
+// Native benchmark of the leibniz kernels, it's built by `make bench`
+// with the same flags as the extension, and prints the results as JSON.
+//
+// Usage: leibniz-bench [--terms N,N,...] [--threads T,T,...] [--repeat R] [--from I]
+//
+// Every kernel supported by the CPU runs every variant on a single thread,
+// then the widest kernel runs with every thread count.
+// Last, the kernels with a fast precision report its error for every number of steps.
+// The terms start at index I, 0 by default, so --from 4611686018427387904
+// measures the kernels past 2^53, where the denominators are 64 bit integers
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "kernel.h"
+#include "job.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define MAX_VALUES 32
+#define MAX_KERNELS 8
+// Terms summed to check the error of precision: :fast
+#define ACCURACY_TERMS 10000000
+
+typedef struct {
+  const char *name;
+  kernel_mode_t mode;
+} variant_t;
+
+static const variant_t variants[] = {
+  { "double", { TYPE_DOUBLE, PRECISION_EXACT, KERNEL_DEFAULT_STEPS } },
+  { "fast", { TYPE_DOUBLE, PRECISION_FAST, KERNEL_DEFAULT_STEPS } },
+  { "float32", { TYPE_FLOAT32, PRECISION_EXACT, KERNEL_DEFAULT_STEPS } },
+  { "double_double", { TYPE_DOUBLE_DOUBLE, PRECISION_EXACT, KERNEL_DEFAULT_STEPS } },
+};
+#define VARIANTS (sizeof(variants) / sizeof(variants[0]))
+
+// Core cycles from perf when it's allowed, otherwise the time stamp counter
+typedef struct {
+  int fd;
+  const char *source;
+} counter_t;
+
+static void counter_open(counter_t *counter) {
+  counter->fd = -1;
+  counter->source = "none";
+
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // Counts the job threads too, they're joined before the counter is read
+  attr.inherit = 1;
+
+  counter->fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if(counter->fd >= 0) {
+    counter->source = "perf";
+    return;
+  }
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  counter->source = "tsc";
+#endif
+}
+
+static uint64_t counter_read(const counter_t *counter) {
+  uint64_t value = 0;
+
+  if(counter->fd >= 0) {
+    if(read(counter->fd, &value, sizeof(value)) != sizeof(value)) value = 0;
+    return value;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  value = __rdtsc();
+#endif
+
+  return value;
+}
+
+// Parses a comma separated list of numbers
+static size_t parse_list(const char *arg, size_t *values) {
+  size_t count = 0;
+  char *end;
+
+  while(*arg && count < MAX_VALUES) {
+    values[count++] = strtoull(arg, &end, 10);
+    if(*end != ',') break;
+    arg = end + 1;
+  }
+
+  return count;
+}
+
+// Runs the job `repeat` times, keeping the fastest run
+static void measure(const counter_t *counter, const kernel_t *kernel, const variant_t *variant,
+                    size_t from, size_t terms, unsigned threads, int repeat, int *first) {
+  double best = 0.0;
+  uint64_t cycles = 0;
+  double estimate = 0.0;
+
+  for(int r = 0; r < repeat; ++r) {
+    job_t job;
+    job_init(&job, kernel, from, from + terms, threads);
+    job.mode = variant->mode;
+
+    uint64_t start_cycles = counter_read(counter);
+    double start = job_clock();
+    job_run(&job);
+    double seconds = job_clock() - start;
+    uint64_t end_cycles = counter_read(counter);
+
+    if(r == 0 || seconds < best) {
+      best = seconds;
+      cycles = end_cycles - start_cycles;
+    }
+    estimate = job_sum(&job) * 4.0;
+  }
+
+  printf("%s\n    {\"kernel\": \"%s\", \"variant\": \"%s\", \"from\": %zu, \"terms\": %zu, \"threads\": %u, "
+         "\"seconds\": %.9f, \"cycles\": %llu, \"terms_per_second\": %.1f, \"cycles_per_term\": %.4f, "
+         "\"estimate\": %.17g}",
+         *first ? "" : ",", kernel->name, variant->name, from, terms, threads,
+         best, (unsigned long long) cycles, terms / best, terms ? (double) cycles / terms : 0.0,
+         estimate);
+  *first = 0;
+  fflush(stdout);
+}
+
+// Sum of the terms in [0, terms) with a kernel and mode, on a single thread
+static double estimate(const kernel_t *kernel, kernel_mode_t mode, size_t terms) {
+  job_t job;
+  job_init(&job, kernel, 0, terms, 1);
+  job.mode = mode;
+  job_run(&job);
+
+  return job_sum(&job) * 4.0;
+}
+
+// Relative difference of precision: :fast from the exact kernel, for every number of steps.
+// bench.rb checks it against a bound for each step count
+static void accuracy(const kernel_t *kernel, int *first) {
+  const size_t terms = ACCURACY_TERMS;
+  kernel_mode_t mode = { TYPE_DOUBLE, PRECISION_EXACT, KERNEL_DEFAULT_STEPS };
+  double exact = estimate(kernel, mode, terms);
+
+  mode.precision = PRECISION_FAST;
+  for(int steps = 0; steps <= KERNEL_MAX_STEPS; ++steps) {
+    mode.steps = steps;
+    double fast = estimate(kernel, mode, terms);
+
+    printf("%s\n    {\"kernel\": \"%s\", \"steps\": %d, \"terms\": %zu, \"estimate\": %.17g, "
+           "\"exact\": %.17g, \"relative_error\": %.3e}",
+           *first ? "" : ",", kernel->name, steps, terms, fast, exact, fabs(fast - exact) / exact);
+    *first = 0;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t terms[MAX_VALUES] = { 1000000, 10000000, 100000000 };
+  size_t terms_count = 3;
+  size_t threads[MAX_VALUES];
+  size_t threads_count = 0;
+  int repeat = 3;
+  size_t from = 0;
+
+  for(int i = 1; i < argc; ++i) {
+    if(!strcmp(argv[i], "--terms") && i + 1 < argc) {
+      terms_count = parse_list(argv[++i], terms);
+    } else if(!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads_count = parse_list(argv[++i], threads);
+    } else if(!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+      if(repeat < 1) repeat = 1;
+    } else if(!strcmp(argv[i], "--from") && i + 1 < argc) {
+      from = strtoull(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--terms N,N,...] [--threads T,T,...] [--repeat R] [--from I]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // By default, powers of two up to the number of CPUs
+  if(threads_count == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for(size_t t = 1; t <= (size_t) cpus && threads_count < MAX_VALUES; t *= 2) {
+      threads[threads_count++] = t;
+    }
+    if(threads[threads_count - 1] != (size_t) cpus && threads_count < MAX_VALUES) {
+      threads[threads_count++] = (size_t) cpus;
+    }
+  }
+
+  counter_t counter;
+  counter_open(&counter);
+
+  const kernel_t *kernels[MAX_KERNELS];
+  size_t kernels_count = kernel_available(kernels, MAX_KERNELS);
+  int first = 1;
+
+  printf("{\n  \"cycles_source\": \"%s\",\n  \"selected\": \"%s\",\n  \"kernels\": [",
+         counter.source, kernels[kernels_count - 1]->name);
+
+  for(size_t k = 0; k < kernels_count; ++k) {
+    for(size_t v = 0; v < VARIANTS; ++v) {
+      // Without a fast version, it would be the same as the double variant
+      if(variants[v].mode.precision == PRECISION_FAST && !kernels[k]->sum_fast) continue;
+
+      for(size_t t = 0; t < terms_count; ++t) {
+        measure(&counter, kernels[k], &variants[v], from, terms[t], 1, repeat, &first);
+      }
+    }
+  }
+
+  printf("\n  ],\n  \"threads\": [");
+  first = 1;
+
+  for(size_t t = 0; t < terms_count; ++t) {
+    for(size_t i = 0; i < threads_count; ++i) {
+      measure(&counter, kernels[kernels_count - 1], &variants[0], from, terms[t], (unsigned) threads[i], repeat, &first);
+    }
+  }
+
+  printf("\n  ],\n  \"accuracy\": [");
+  first = 1;
+
+  for(size_t k = 0; k < kernels_count; ++k) {
+    if(kernels[k]->sum_fast) accuracy(kernels[k], &first);
+  }
+
+  printf("\n  ]\n}\n");
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+#!/usr/bin/env ruby
+
+# Benchmarks the leibniz extension, run it with `make bench` or directly after building
+# the extension and the native benchmark (`make leibniz-bench`) in the leibniz directory.
+#
+# The kernels are measured by the native benchmark (bench.c), and this script adds
+# the cost of calling Leibniz.calc from Ruby, and the accelerated Leibniz.calc_to_precision.
+# Leibniz.calc also runs in several Ractors at once, to check that the throughput scales with them.
+# The error of precision: :fast against the exact kernels is checked for every number of steps.
+# The results are printed as JSON, and with --compare they're checked against a saved baseline.
+
+require 'etc'
+require 'json'
+require 'optparse'
+require 'rbconfig'
+
+ROOT = File.expand_path('..', __dir__)
+require File.join(ROOT, 'leibniz.so')
+
+options = {
+  native: [],
+  ractors: nil,
+  ractor_terms: 200_000_000,
+  tolerance: 5.0
+}
+
+OptionParser.new do |opts|
+  opts.banner = "Usage: #{$0} [options]"
+
+  opts.on('--terms N,N', 'Term counts of the native benchmark') { options[:native] += ['--terms', it] }
+  opts.on('--threads T,T', 'Thread counts of the native benchmark') { options[:native] += ['--threads', it] }
+  opts.on('--repeat R', 'Runs of each native benchmark, the fastest is kept') { options[:native] += ['--repeat', it] }
+  opts.on('--from I', 'First term of the native benchmark, past 2**53 it measures the 64 bit indices') { options[:native] += ['--from', it] }
+  opts.on('--quick', 'Smaller sweep, used to train the PGO builds') do
+    options[:native] += ['--terms', '1000000,10000000', '--threads', '1,2', '--repeat', '1']
+    options[:ractor_terms] = 20_000_000
+  end
+  opts.on('--ractors R,R', Array, 'Ractor counts of the scaling check (default: powers of two up to the physical cores)') do
+    options[:ractors] = it.map(&:to_i)
+  end
+  opts.on('--min-scaling PERCENT', Float, 'Fails when the Ractors scale below this efficiency') { options[:min_scaling] = it }
+  opts.on('-o', '--output FILE', 'Writes the JSON to a file instead of stdout') { options[:output] = it }
+  opts.on('--compare BASELINE', 'Flags the regressions against a previous output') { options[:compare] = it }
+  opts.on('--tolerance PERCENT', Float, 'Allowed slowdown before flagging (default 5)') { options[:tolerance] = it }
+end.parse!
+
+def cpu_name
+  File.foreach('/proc/cpuinfo').find { it.start_with?('model name') }&.split(':', 2)&.last&.strip
+rescue Errno::ENOENT
+  RbConfig::CONFIG['host_cpu']
+end
+
+# Cores without their SMT siblings, which share the divider and would never scale.
+# Without core ids in /proc/cpuinfo (e.g. on ARM), every CPU is a core
+def physical_cores
+  cores = File.read('/proc/cpuinfo').scan(/^physical id\s*:\s*(\d+)\n(?:.*\n)*?core id\s*:\s*(\d+)/).uniq.size
+  cores.zero? ? Etc.nprocessors : cores
+rescue Errno::ENOENT
+  Etc.nprocessors
+end
+
+def clock
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+# Calls the block for at least `duration` seconds, returning the nanoseconds per call
+def per_call(duration = 0.2)
+  calls = 0
+  start = clock
+  elapsed = 0.0
+
+  while elapsed < duration
+    100.times { yield }
+    calls += 100
+    elapsed = clock - start
+  end
+
+  elapsed * 1e9 / calls
+end
+
+# Runs Leibniz.calc(terms) once in each of `count` Ractors at the same time
+def ractors(count, terms)
+  start = clock
+  count.times.map { Ractor.new(terms) { Leibniz.calc it } }.each do
+    it.respond_to?(:value) ? it.value : it.take
+  end
+
+  clock - start
+end
+
+# Throughput of the Ractors, the efficiency compares it with `count` times the throughput of one
+def ractor_scaling(counts, terms)
+  Warning[:experimental] = false
+  single = nil
+
+  counts.map do |count|
+    seconds = ractors(count, terms)
+    terms_per_second = count * terms / seconds
+    single ||= terms_per_second / count
+
+    { ractors: count, terms:, seconds:, terms_per_second:, efficiency: terms_per_second / (single * count) * 100 }
+  end
+end
+
+# Largest relative error of precision: :fast for each number of steps.
+# The reciprocal estimate is within 1.5 * 2**-12 of 1 / x, and every Newton-Raphson step
+# squares the error, until it's down to the rounding of the sum
+FAST_ERROR_BOUNDS = [2**-10, 2**-20, 2**-44, 2**-46].freeze
+
+cores = physical_cores
+options[:ractors] ||= [1, 2, 4, 8, 16, 32, 64].select { it <= cores } | [cores]
+options[:ractors] = [1] | options[:ractors]
+
+native = File.join(ROOT, 'leibniz-bench')
+abort "#{native} not found, build it with `make leibniz-bench`" unless File.executable?(native)
+
+output = IO.popen([native, *options[:native]], &:read)
+abort 'native benchmark failed' unless $?.success?
+
+results = {
+  cpu: cpu_name,
+  ruby: RUBY_DESCRIPTION,
+  kernel: Leibniz.kernel,
+  native: JSON.parse(output),
+  overhead: [0, 1, 16, 256, 4096].map do |terms|
+    { method: 'calc', terms:, ns_per_call: per_call { Leibniz.calc terms } }
+  end,
+  accelerated: [6, 12, 15].map do |digits|
+    _, terms = Leibniz.calc_to_precision digits
+    { digits:, terms:, ns_per_call: per_call { Leibniz.calc_to_precision digits } }
+  end,
+  ractors: ractor_scaling(options[:ractors], options[:ractor_terms])
+}
+
+json = JSON.pretty_generate(results)
+if options[:output]
+  File.write options[:output], json
+else
+  puts json
+end
+
+poor_scaling = options[:min_scaling] ? results[:ractors].select { it[:efficiency] < options[:min_scaling] } : []
+poor_scaling.each do
+  warn format('%d Ractors scale at %.1f%%, below %.1f%%', it[:ractors], it[:efficiency], options[:min_scaling])
+end
+
+inaccurate = results[:native]['accuracy'].select { it['relative_error'] > FAST_ERROR_BOUNDS[it['steps']] }
+inaccurate.each do
+  warn format('%s precision: :fast with %d steps is off by %.3e, above %.3e',
+              it['kernel'], it['steps'], it['relative_error'], FAST_ERROR_BOUNDS[it['steps']])
+end
+
+failed = poor_scaling.any? || inaccurate.any?
+exit !failed unless options[:compare]
+
+baseline = JSON.parse(File.read(options[:compare]))
+current = JSON.parse(json)
+tolerance = options[:tolerance] / 100.0
+regressions = []
+
+# Higher is better for terms_per_second, lower is better for ns_per_call
+compare = lambda do |section, key, metric, higher_is_better|
+  previous = Array(section.call(baseline)).to_h { [key.call(it), it[metric]] }
+
+  Array(section.call(current)).each do |entry|
+    before = previous[key.call(entry)] or next
+    after = entry[metric]
+    change = higher_is_better ? (before - after) / before : (after - before) / before
+
+    regressions << [key.call(entry).join(' '), metric, before, after, change] if change > tolerance
+  end
+end
+
+native_key = ->(entry) { [entry['kernel'], entry['variant'], entry['terms'], "#{entry['threads']} threads"] }
+compare.call(->(r) { r['native']['kernels'] }, native_key, 'terms_per_second', true)
+compare.call(->(r) { r['native']['threads'] }, native_key, 'terms_per_second', true)
+compare.call(->(r) { r['overhead'] }, ->(entry) { [entry['method'], entry['terms']] }, 'ns_per_call', false)
+compare.call(->(r) { r['ractors'] }, ->(entry) { ["#{entry['ractors']} ractors", entry['terms']] }, 'terms_per_second', true)
+compare.call(->(r) { r['accelerated'] }, ->(entry) { ['calc_to_precision', entry['digits']] }, 'ns_per_call', false)
+
+if regressions.empty?
+  warn "No regressions against #{options[:compare]}"
+  exit 1 if failed
+else
+  warn "Regressions against #{options[:compare]} (tolerance #{options[:tolerance]}%):"
+  regressions.each do |name, metric, before, after, change|
+    warn format('  %-45s %-16s %14.1f -> %14.1f (%.1f%% worse)', name, metric, before, after, change * 100)
+  end
+  exit 1
+end
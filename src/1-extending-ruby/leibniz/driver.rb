@@ -0,0 +1,116 @@
+#!/usr/bin/env ruby
+
+require_relative 'leibniz.so'
+require 'socket'
+
+module Leibniz
+  # Each request is a range of terms, [from, to) as two unsigned 64 bits integers,
+  # and each response is the partial sum of that range as a double
+  REQUEST = 'Q<Q<'
+  RESPONSE = 'E'
+
+  # Serves Leibniz.partial_sum requests, until the driver closes the socket
+  module Worker
+    def self.handle(socket, threads: 1)
+      while (request = socket.read(16))
+        from, to = request.unpack(REQUEST)
+        socket.write [Leibniz.partial_sum(from, to, threads:)].pack(RESPONSE)
+      end
+    ensure
+      socket.close
+    end
+
+    # Listens on a Unix socket, handling one driver at a time
+    def self.serve(path, threads: 1)
+      server = UNIXServer.new path
+
+      loop do
+        handle(server.accept, threads:)
+      end
+    ensure
+      server&.close
+      File.delete(path) if File.socket?(path)
+    end
+  end
+
+  # Splits the terms of a computation in ranges and hands them out to the workers.
+  # A worker gets a new range as soon as it answers the previous one, and the results
+  # are added in range order, so the estimate doesn't depend on which worker computed what
+  module Driver
+    CHUNK = 1 << 26
+
+    # Forks `workers` processes to compute the first n terms
+    def self.fork(n, workers: 2, threads: 1, chunk: CHUNK)
+      sockets = []
+      pids = workers.times.map do
+        parent, child = UNIXSocket.pair
+        sockets << parent
+
+        Process.fork do
+          sockets.each(&:close)
+          Worker.handle(child, threads:)
+          exit! 0
+        end.tap { child.close }
+      end
+
+      calc(n, sockets, chunk:)
+    ensure
+      sockets.each(&:close)
+      pids&.each { Process.wait it }
+    end
+
+    # Uses the workers listening on the given Unix sockets to compute the first n terms
+    def self.connect(n, paths, chunk: CHUNK)
+      sockets = paths.map { UNIXSocket.new it }
+
+      calc(n, sockets, chunk:)
+    ensure
+      sockets&.each(&:close)
+    end
+
+    def self.calc(n, sockets, chunk: CHUNK)
+      ranges = (0...n).step(chunk).map { [it, [it + chunk, n].min] }
+      results = Array.new(ranges.size)
+      pending = {}
+      next_range = 0
+
+      send_range = lambda do |socket|
+        return if next_range >= ranges.size
+
+        socket.write ranges[next_range].pack(REQUEST)
+        pending[socket] = next_range
+        next_range += 1
+      end
+
+      sockets.each(&send_range)
+
+      until pending.empty?
+        ready, = IO.select(pending.keys)
+        ready.each do |socket|
+          response = socket.read(8) or raise IOError, 'worker closed the connection'
+          results[pending.delete(socket)] = response.unpack1(RESPONSE)
+          send_range.call socket
+        end
+      end
+
+      results.sum
+    end
+  end
+end
+
+if __FILE__ == $0
+  case ARGV.shift
+  when 'serve'
+    # Exiting runs the ensure blocks, so the socket file is removed
+    Signal.trap('TERM') { exit }
+    Signal.trap('INT') { exit }
+    Leibniz::Worker.serve ARGV.fetch(0)
+  when 'fork'
+    puts Leibniz::Driver.fork(Integer(ARGV.fetch(0)), workers: Integer(ARGV.fetch(1, 2)))
+  when 'connect'
+    puts Leibniz::Driver.connect(Integer(ARGV.shift), ARGV)
+  else
+    puts "Usage: #{$0} serve PATH | fork N [WORKERS] | connect N PATH..."
+    exit 1
+  end
+end
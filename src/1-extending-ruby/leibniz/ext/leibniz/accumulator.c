@@ -0,0 +1,122 @@
+#include <math.h>
+#include "leibniz.h"
+
+// Running sum of the series, so an estimate can be refined
+// without computing the first terms again
+typedef struct {
+  double sum;
+  // Neumaier compensation of the rounding errors of sum
+  double compensation;
+  // Index of the next term to be computed
+  size_t next;
+  // Set while advance runs without the GVL
+  int busy;
+} accumulator_t;
+
+static const rb_data_type_t accumulator_type = {
+  .wrap_struct_name = "Leibniz::Accumulator",
+  .function = {
+    .dfree = RUBY_TYPED_DEFAULT_FREE,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE accumulator_alloc(VALUE klass) {
+  accumulator_t *acc;
+
+  return TypedData_Make_Struct(klass, accumulator_t, &accumulator_type, acc);
+}
+
+static accumulator_t *get_accumulator(VALUE self) {
+  accumulator_t *acc;
+  TypedData_Get_Struct(self, accumulator_t, &accumulator_type, acc);
+
+  return acc;
+}
+
+static void add(accumulator_t *acc, double value) {
+  double total = acc->sum + value;
+
+  if(fabs(acc->sum) >= fabs(value)) {
+    acc->compensation += (acc->sum - total) + value;
+  } else {
+    acc->compensation += (value - total) + acc->sum;
+  }
+  acc->sum = total;
+}
+
+static double estimate(const accumulator_t *acc) {
+  return (acc->sum + acc->compensation) * 4.0;
+}
+
+static VALUE advance_job(VALUE job) {
+  run_job((job_t *) job);
+
+  return Qnil;
+}
+
+// Leibniz::Accumulator#advance(k, **options), takes the same options as Leibniz.calc
+// Computes the next k terms. If it's interrupted, the terms computed
+// until then are kept, so calling advance again picks up from there
+static VALUE accumulator_advance(int argc, VALUE *argv, VALUE self) {
+  VALUE times, opts;
+  calc_options options;
+  job_t job;
+  int state;
+  accumulator_t *acc = get_accumulator(self);
+
+  rb_scan_args(argc, argv, "1:", &times, &opts);
+  size_t k = RB_NUM2SIZE(times);
+  parse_options(opts, &options);
+  rb_check_frozen(self);
+
+  if(acc->busy) rb_raise(rb_eRuntimeError, "accumulator is already advancing in another thread");
+  if(k > KERNEL_MAX_TERMS - acc->next) rb_raise(rb_eRangeError, "at most 2**63 terms are supported");
+
+  prepare_job(&job, acc->next, acc->next + k, &options);
+  acc->busy = 1;
+  rb_protect(advance_job, (VALUE) &job, &state);
+  acc->busy = 0;
+
+  add(acc, job.sum.hi);
+  add(acc, job.sum.lo);
+  acc->next += job.done;
+
+  if(state) rb_jump_tag(state);
+  if(atomic_load(&job.status) == JOB_EXPIRED) {
+    raise_timeout(job.done, k, estimate(acc), acc->next);
+  }
+
+  return self;
+}
+
+// Current estimate of pi
+static VALUE accumulator_value(VALUE self) {
+  return rb_float_new(estimate(get_accumulator(self)));
+}
+
+// How many terms were computed so far
+static VALUE accumulator_terms(VALUE self) {
+  return RB_SIZE2NUM(get_accumulator(self)->next);
+}
+
+static VALUE accumulator_initialize_copy(VALUE self, VALUE other) {
+  accumulator_t *acc = get_accumulator(self);
+
+  rb_check_frozen(self);
+  *acc = *get_accumulator(other);
+  acc->busy = 0;
+
+  return self;
+}
+
+VALUE init_accumulator(VALUE super) {
+  VALUE accumulatorClass = rb_define_class_under(super, "Accumulator", rb_cObject);
+  rb_define_alloc_func(accumulatorClass, accumulator_alloc);
+  rb_define_method(accumulatorClass, "initialize_copy", accumulator_initialize_copy, 1);
+  rb_define_method(accumulatorClass, "advance", accumulator_advance, -1);
+  rb_define_method(accumulatorClass, "value", accumulator_value, 0);
+  rb_define_method(accumulatorClass, "terms", accumulator_terms, 0);
+
+  return accumulatorClass;
+}
@@ -0,0 +1,494 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bigint.h"
+
+// Below KARATSUBA_THRESHOLD limbs the schoolbook multiplication is used,
+// from NTT_THRESHOLD limbs on, the number theoretic transform
+#define KARATSUBA_THRESHOLD 40
+#define NTT_THRESHOLD 800
+
+// NULL when there's no memory left, or when the size doesn't fit in a size_t
+static void *allocate(size_t count, size_t size) {
+  if(size && count > SIZE_MAX / size) return NULL;
+
+  return malloc(count ? count * size : 1);
+}
+
+static uint32_t *new_limbs(size_t count) {
+  return allocate(count, sizeof(uint32_t));
+}
+
+static size_t trim(const uint32_t *limbs, size_t size) {
+  while(size > 0 && limbs[size - 1] == 0) --size;
+
+  return size;
+}
+
+// Replaces the limbs of r, which may be used by the arguments until then
+static void replace(bigint_t *r, uint32_t *limbs, size_t size, int negative) {
+  free(r->limbs);
+  r->limbs = limbs;
+  r->size = trim(limbs, size);
+  r->negative = r->size ? negative : 0;
+  r->invalid = 0;
+}
+
+void bigint_init(bigint_t *x) {
+  x->limbs = NULL;
+  x->size = 0;
+  x->negative = 0;
+  x->invalid = 0;
+}
+
+void bigint_free(bigint_t *x) {
+  free(x->limbs);
+  bigint_init(x);
+}
+
+// Marks r invalid after an allocation failed or an argument was invalid
+static void invalidate(bigint_t *r) {
+  bigint_free(r);
+  r->invalid = 1;
+}
+
+void bigint_set_u64(bigint_t *r, uint64_t value) {
+  uint32_t *limbs = new_limbs(3);
+  if(!limbs) {
+    invalidate(r);
+    return;
+  }
+
+  for(int i = 0; i < 3; ++i) {
+    limbs[i] = (uint32_t) (value % BIGINT_BASE);
+    value /= BIGINT_BASE;
+  }
+
+  replace(r, limbs, 3, 0);
+}
+
+// r = a + b, with na >= nb, r has room for na limbs. Returns the carry
+static uint32_t add_limbs(uint32_t *r, const uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  uint32_t carry = 0;
+
+  for(size_t i = 0; i < na; ++i) {
+    uint32_t sum = a[i] + (i < nb ? b[i] : 0) + carry;
+    carry = sum >= BIGINT_BASE;
+    r[i] = carry ? sum - BIGINT_BASE : sum;
+  }
+
+  return carry;
+}
+
+// a -= b, with a >= b
+static void sub_limbs(uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  uint32_t borrow = 0;
+
+  for(size_t i = 0; i < na && (i < nb || borrow); ++i) {
+    uint32_t sub = (i < nb ? b[i] : 0) + borrow;
+    borrow = a[i] < sub;
+    a[i] = borrow ? a[i] + BIGINT_BASE - sub : a[i] - sub;
+  }
+}
+
+// a += b, where the sum fits in na limbs
+static void add_into(uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  uint32_t carry = 0;
+
+  for(size_t i = 0; i < na && (i < nb || carry); ++i) {
+    uint32_t sum = a[i] + (i < nb ? b[i] : 0) + carry;
+    carry = sum >= BIGINT_BASE;
+    a[i] = carry ? sum - BIGINT_BASE : sum;
+  }
+}
+
+static int compare_limbs(const uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  if(na != nb) return na < nb ? -1 : 1;
+
+  for(size_t i = na; i-- > 0;) {
+    if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+
+  return 0;
+}
+
+// Each row is added with its own carries, a product is below 10^16 so it never overflows
+static void mul_schoolbook(uint32_t *r, const uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  memset(r, 0, (na + nb) * sizeof(uint32_t));
+
+  for(size_t i = 0; i < na; ++i) {
+    uint64_t carry = 0;
+    uint64_t ai = a[i];
+
+    for(size_t j = 0; j < nb; ++j) {
+      uint64_t t = r[i + j] + ai * b[j] + carry;
+      r[i + j] = (uint32_t) (t % BIGINT_BASE);
+      carry = t / BIGINT_BASE;
+    }
+    r[i + nb] = (uint32_t) carry;
+  }
+}
+
+// Number theoretic transform modulo the Goldilocks prime p = 2^64 - 2^32 + 1.
+// The limbs are split into digits below 10^4, so a coefficient of the product
+// is below n * 10^8 and fits in p for any length that fits in memory
+#define NTT_P 0xffffffff00000001ull
+// 2^64 mod p
+#define NTT_EPSILON 0xffffffffull
+// 7 generates the multiplicative group
+#define NTT_GENERATOR 7
+
+// The reductions use masks instead of branches, the values are random so they'd be mispredicted
+static inline uint64_t ntt_mask(int condition) {
+  return -(uint64_t) condition;
+}
+
+static inline uint64_t ntt_add(uint64_t a, uint64_t b) {
+  uint64_t complement = NTT_P - b;
+
+  return a - complement + (NTT_P & ntt_mask(a < complement));
+}
+
+static inline uint64_t ntt_sub(uint64_t a, uint64_t b) {
+  return a - b + (NTT_P & ntt_mask(a < b));
+}
+
+// With 2^64 = 2^32 - 1 and 2^96 = -1 (mod p), the 128 bit product reduces with a few additions
+static inline uint64_t ntt_mul(uint64_t a, uint64_t b) {
+  unsigned __int128 x = (unsigned __int128) a * b;
+  uint64_t lo = (uint64_t) x;
+  uint64_t hi = (uint64_t) (x >> 64);
+  uint64_t hi_hi = hi >> 32;
+  uint64_t hi_lo = hi & NTT_EPSILON;
+
+  uint64_t t0 = lo - hi_hi - (NTT_EPSILON & ntt_mask(lo < hi_hi));
+  uint64_t t1 = hi_lo * NTT_EPSILON;
+  uint64_t t2 = t0 + t1;
+  t2 += NTT_EPSILON & ntt_mask(t2 < t1);
+
+  return t2 - (NTT_P & ntt_mask(t2 >= NTT_P));
+}
+
+static uint64_t ntt_pow(uint64_t base, uint64_t exponent) {
+  uint64_t result = 1;
+
+  for(; exponent; exponent >>= 1) {
+    if(exponent & 1) result = ntt_mul(result, base);
+    base = ntt_mul(base, base);
+  }
+
+  return result;
+}
+
+// Below this length the transforms run the stages in loops, above it they
+// recurse on the halves, so the stages of a block work inside the cache
+#define NTT_LOOP_LENGTH 4096
+
+// The roots of each length of the transform: root_length^j is at twiddles[length / 2 + j]
+static void ntt_twiddles(uint64_t *twiddles, size_t n, int inverse) {
+  for(size_t length = 2; length <= n; length <<= 1) {
+    uint64_t root = ntt_pow(NTT_GENERATOR, (NTT_P - 1) / length);
+    uint64_t *level = twiddles + length / 2;
+
+    if(inverse) root = ntt_pow(root, NTT_P - 2);
+    level[0] = 1;
+    for(size_t j = 1; j < length / 2; ++j) level[j] = ntt_mul(level[j - 1], root);
+  }
+}
+
+// Forward transform, decimation in frequency: the output is in bit reversed order,
+// which is the order the inverse transform takes, so no reordering is needed
+static void ntt_forward(uint64_t *a, size_t n, const uint64_t *twiddles) {
+  size_t last = n > NTT_LOOP_LENGTH ? n : 2;
+
+  for(size_t length = n; length >= last; length >>= 1) {
+    size_t half = length / 2;
+    const uint64_t *level = twiddles + half;
+
+    for(size_t start = 0; start < n; start += length) {
+      for(size_t j = 0; j < half; ++j) {
+        uint64_t u = a[start + j];
+        uint64_t v = a[start + j + half];
+
+        a[start + j] = ntt_add(u, v);
+        a[start + j + half] = ntt_mul(ntt_sub(u, v), level[j]);
+      }
+    }
+  }
+
+  if(n > NTT_LOOP_LENGTH) {
+    ntt_forward(a, n / 2, twiddles);
+    ntt_forward(a + n / 2, n / 2, twiddles);
+  }
+}
+
+// Inverse transform, decimation in time, without the division by n
+static void ntt_inverse(uint64_t *a, size_t n, const uint64_t *twiddles) {
+  size_t first = 2;
+
+  if(n > NTT_LOOP_LENGTH) {
+    ntt_inverse(a, n / 2, twiddles);
+    ntt_inverse(a + n / 2, n / 2, twiddles);
+    first = n;
+  }
+
+  for(size_t length = first; length <= n; length <<= 1) {
+    size_t half = length / 2;
+    const uint64_t *level = twiddles + half;
+
+    for(size_t start = 0; start < n; start += length) {
+      for(size_t j = 0; j < half; ++j) {
+        uint64_t u = a[start + j];
+        uint64_t v = ntt_mul(a[start + j + half], level[j]);
+
+        a[start + j] = ntt_add(u, v);
+        a[start + j + half] = ntt_sub(u, v);
+      }
+    }
+  }
+}
+
+static void ntt_load(uint64_t *digits, size_t n, const uint32_t *limbs, size_t size) {
+  for(size_t i = 0; i < size; ++i) {
+    digits[2 * i] = limbs[i] % 10000;
+    digits[2 * i + 1] = limbs[i] / 10000;
+  }
+  memset(digits + 2 * size, 0, (n - 2 * size) * sizeof(uint64_t));
+}
+
+static int mul_ntt(uint32_t *r, const uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  size_t digits = 2 * (na + nb);
+  size_t n = 1;
+  while(n < digits) n <<= 1;
+
+  int square = a == b && na == nb;
+  uint64_t *fa = allocate(n, sizeof(uint64_t));
+  uint64_t *fb = square ? fa : allocate(n, sizeof(uint64_t));
+  uint64_t *twiddles = allocate(n, sizeof(uint64_t));
+  if(!fa || !fb || !twiddles) {
+    free(twiddles);
+    if(!square) free(fb);
+    free(fa);
+    return 0;
+  }
+
+  ntt_twiddles(twiddles, n, 0);
+  ntt_load(fa, n, a, na);
+  ntt_forward(fa, n, twiddles);
+  if(!square) {
+    ntt_load(fb, n, b, nb);
+    ntt_forward(fb, n, twiddles);
+  }
+
+  // The division by n of the inverse transform is done with the products
+  uint64_t inverse = ntt_pow(n, NTT_P - 2);
+  for(size_t i = 0; i < n; ++i) fa[i] = ntt_mul(ntt_mul(fa[i], fb[i]), inverse);
+  ntt_twiddles(twiddles, n, 1);
+  ntt_inverse(fa, n, twiddles);
+
+  uint64_t carry = 0;
+  for(size_t i = 0; i < na + nb; ++i) {
+    uint64_t low = fa[2 * i] + carry;
+    uint64_t high = fa[2 * i + 1] + low / 10000;
+
+    r[i] = (uint32_t) (low % 10000 + high % 10000 * 10000);
+    carry = high / 10000;
+  }
+
+  free(twiddles);
+  if(!square) free(fb);
+  free(fa);
+
+  return 1;
+}
+
+static int mul_limbs(uint32_t *r, const uint32_t *a, size_t na, const uint32_t *b, size_t nb);
+
+// a = a1 * BASE^m + a0 and b = b1 * BASE^m + b0, with na >= nb > m.
+// The middle product (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 saves a multiplication
+static int mul_karatsuba(uint32_t *r, const uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  size_t m = na / 2;
+  size_t na1 = na - m;
+  size_t nb1 = nb - m;
+  size_t nsa = na1 + 1;
+  size_t nsb = (nb1 > m ? nb1 : m) + 1;
+
+  if(!mul_limbs(r, a, m, b, m) || !mul_limbs(r + 2 * m, a + m, na1, b + m, nb1)) return 0;
+
+  uint32_t *sa = new_limbs(nsa + nsb + nsa + nsb);
+  if(!sa) return 0;
+  uint32_t *sb = sa + nsa;
+  uint32_t *middle = sb + nsb;
+
+  sa[na1] = add_limbs(sa, a + m, na1, a, m);
+  if(nb1 >= m) {
+    sb[nb1] = add_limbs(sb, b + m, nb1, b, m);
+  } else {
+    sb[m] = add_limbs(sb, b, m, b + m, nb1);
+  }
+
+  size_t nmiddle = nsa + nsb;
+  if(!mul_limbs(middle, sa, trim(sa, nsa), sb, trim(sb, nsb))) {
+    free(sa);
+    return 0;
+  }
+  memset(middle + trim(sa, nsa) + trim(sb, nsb), 0,
+         (nmiddle - trim(sa, nsa) - trim(sb, nsb)) * sizeof(uint32_t));
+
+  sub_limbs(middle, nmiddle, r, 2 * m);
+  sub_limbs(middle, nmiddle, r + 2 * m, na1 + nb1);
+  add_into(r + m, na + nb - m, middle, trim(middle, nmiddle));
+
+  free(sa);
+
+  return 1;
+}
+
+// r = a * b, r has room for na + nb limbs and can't overlap the arguments.
+// Returns 0 when there wasn't enough memory, r is then meaningless
+static int mul_limbs(uint32_t *r, const uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+  if(na < nb) {
+    const uint32_t *swap = a;
+    a = b;
+    b = swap;
+    size_t size = na;
+    na = nb;
+    nb = size;
+  }
+
+  if(nb == 0) {
+    memset(r, 0, na * sizeof(uint32_t));
+  } else if(nb < KARATSUBA_THRESHOLD) {
+    mul_schoolbook(r, a, na, b, nb);
+  } else if(nb >= NTT_THRESHOLD) {
+    return mul_ntt(r, a, na, b, nb);
+  } else if(na >= 2 * nb) {
+    // Very different sizes, a is multiplied by b in pieces of nb limbs
+    uint32_t *piece = new_limbs(2 * nb);
+    if(!piece) return 0;
+
+    memset(r, 0, (na + nb) * sizeof(uint32_t));
+    for(size_t start = 0; start < na; start += nb) {
+      size_t length = na - start < nb ? na - start : nb;
+
+      if(!mul_limbs(piece, a + start, length, b, nb)) {
+        free(piece);
+        return 0;
+      }
+      add_into(r + start, na + nb - start, piece, length + nb);
+    }
+
+    free(piece);
+  } else {
+    return mul_karatsuba(r, a, na, b, nb);
+  }
+
+  return 1;
+}
+
+void bigint_mul(bigint_t *r, const bigint_t *a, const bigint_t *b) {
+  uint32_t *limbs = a->invalid || b->invalid ? NULL : new_limbs(a->size + b->size);
+
+  if(!limbs || !mul_limbs(limbs, a->limbs, a->size, b->limbs, b->size)) {
+    free(limbs);
+    invalidate(r);
+    return;
+  }
+  replace(r, limbs, a->size + b->size, a->negative != b->negative);
+}
+
+void bigint_add(bigint_t *r, const bigint_t *a, const bigint_t *b) {
+  if(a->size < b->size) {
+    const bigint_t *swap = a;
+    a = b;
+    b = swap;
+  }
+
+  uint32_t *limbs = a->invalid || b->invalid ? NULL : new_limbs(a->size + 1);
+  if(!limbs) {
+    invalidate(r);
+    return;
+  }
+
+  if(a->negative == b->negative) {
+    limbs[a->size] = add_limbs(limbs, a->limbs, a->size, b->limbs, b->size);
+    replace(r, limbs, a->size + 1, a->negative);
+    return;
+  }
+
+  // Different signs, the smaller magnitude is subtracted from the larger one
+  int order = compare_limbs(a->limbs, a->size, b->limbs, b->size);
+  const bigint_t *large = order >= 0 ? a : b;
+  const bigint_t *small = order >= 0 ? b : a;
+
+  memcpy(limbs, large->limbs, large->size * sizeof(uint32_t));
+  sub_limbs(limbs, large->size, small->limbs, small->size);
+  replace(r, limbs, large->size, large->negative);
+}
+
+void bigint_mul_small(bigint_t *r, const bigint_t *a, uint32_t m) {
+  uint32_t *limbs = a->invalid ? NULL : new_limbs(a->size + 2);
+  uint64_t carry = 0;
+
+  if(!limbs) {
+    invalidate(r);
+    return;
+  }
+
+  for(size_t i = 0; i < a->size; ++i) {
+    uint64_t t = (uint64_t) a->limbs[i] * m + carry;
+    limbs[i] = (uint32_t) (t % BIGINT_BASE);
+    carry = t / BIGINT_BASE;
+  }
+  limbs[a->size] = (uint32_t) (carry % BIGINT_BASE);
+  limbs[a->size + 1] = (uint32_t) (carry / BIGINT_BASE);
+
+  replace(r, limbs, a->size + 2, a->negative);
+}
+
+void bigint_div_small(bigint_t *r, const bigint_t *a, uint32_t d) {
+  uint32_t *limbs = a->invalid ? NULL : new_limbs(a->size);
+  uint64_t remainder = 0;
+
+  if(!limbs) {
+    invalidate(r);
+    return;
+  }
+
+  for(size_t i = a->size; i-- > 0;) {
+    uint64_t t = remainder * BIGINT_BASE + a->limbs[i];
+    limbs[i] = (uint32_t) (t / d);
+    remainder = t % d;
+  }
+
+  replace(r, limbs, a->size, a->negative);
+}
+
+void bigint_shift(bigint_t *r, const bigint_t *a, ptrdiff_t shift) {
+  size_t size = a->size;
+
+  if(a->invalid) {
+    invalidate(r);
+    return;
+  }
+
+  if(shift < 0 && (size_t) -shift >= size) {
+    replace(r, NULL, 0, 0);
+    return;
+  }
+
+  size_t new_size = shift < 0 ? size - (size_t) -shift : size + (size_t) shift;
+  uint32_t *limbs = new_limbs(new_size);
+  if(!limbs) {
+    invalidate(r);
+    return;
+  }
+
+  if(shift < 0) {
+    memcpy(limbs, a->limbs + -shift, new_size * sizeof(uint32_t));
+  } else {
+    memset(limbs, 0, (size_t) shift * sizeof(uint32_t));
+    memcpy(limbs + shift, a->limbs, size * sizeof(uint32_t));
+  }
+
+  replace(r, limbs, new_size, a->negative);
+}
@@ -0,0 +1,37 @@
+#ifndef LEIBNIZ_BIGINT_H
+#define LEIBNIZ_BIGINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Limbs of 8 decimal digits, so printing a number doesn't need a base conversion
+#define BIGINT_BASE 100000000u
+#define BIGINT_DIGITS 8
+
+// Signed integer, the value is sum(limbs[i] * BASE^i), negated when negative is set.
+// There are no leading zero limbs, and zero has no limbs at all
+typedef struct {
+  uint32_t *limbs;
+  size_t size;
+  int negative;
+  // Set when there wasn't enough memory for it, the value is then meaningless
+  int invalid;
+} bigint_t;
+
+// The functions don't touch the Ruby VM, so they can run without the GVL.
+// When there's no memory left, the result is invalid instead of aborting,
+// and an operation with an invalid argument gives an invalid result,
+// so only the final values need to be checked.
+// The result can be any of the arguments
+void bigint_init(bigint_t *x);
+void bigint_free(bigint_t *x);
+void bigint_set_u64(bigint_t *r, uint64_t value);
+void bigint_add(bigint_t *r, const bigint_t *a, const bigint_t *b);
+void bigint_mul(bigint_t *r, const bigint_t *a, const bigint_t *b);
+void bigint_mul_small(bigint_t *r, const bigint_t *a, uint32_t m);
+// Divides by d, rounding toward zero
+void bigint_div_small(bigint_t *r, const bigint_t *a, uint32_t d);
+// Multiplies by BASE^limbs, or divides by BASE^-limbs rounding toward zero when it's negative
+void bigint_shift(bigint_t *r, const bigint_t *a, ptrdiff_t limbs);
+
+#endif
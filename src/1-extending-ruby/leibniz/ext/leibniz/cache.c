@@ -0,0 +1,187 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+
+#define CACHE_MAGIC "LEIBNIZ"
+
+// Written once by the process that creates the file, under an exclusive flock.
+// Everything but count is checked against the kernel and mode when it's opened
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  int32_t type;
+  int32_t precision;
+  int32_t steps;
+  char kernel[16];
+  uint64_t block;
+  uint64_t stride;
+  uint64_t capacity;
+  // How many checkpoints are stored, they're always the first ones
+  _Atomic uint64_t count;
+  char reserved[56];
+} cache_header_t;
+
+_Static_assert(sizeof(cache_header_t) == 128, "the checkpoints start at a fixed offset");
+
+typedef struct {
+  cache_header_t header;
+  dd_t sums[CACHE_CAPACITY];
+} cache_file_t;
+
+struct cache {
+  cache_file_t *file;
+  kernel_mode_t mode;
+  atomic_int refs;
+};
+
+// The cache of the whole process, read by every Ractor but only installed by the main one
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static cache_t *installed;
+
+static void write_header(cache_header_t *header, const kernel_t *kernel, const kernel_mode_t *mode) {
+  header->version = CACHE_VERSION;
+  header->type = mode->type;
+  header->precision = mode->precision;
+  header->steps = mode->steps;
+  strncpy(header->kernel, kernel->name, sizeof(header->kernel) - 1);
+  header->block = JOB_BLOCK;
+  header->stride = CACHE_STRIDE;
+  header->capacity = CACHE_CAPACITY;
+  atomic_store(&header->count, 0);
+  // Last, so a file left half written by a crash is written again
+  memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+}
+
+static int check_header(const cache_header_t *header, const kernel_t *kernel, const kernel_mode_t *mode) {
+  return memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+         header->version == CACHE_VERSION &&
+         header->type == (int32_t) mode->type &&
+         header->precision == (int32_t) mode->precision &&
+         header->steps == mode->steps &&
+         strncmp(header->kernel, kernel->name, sizeof(header->kernel)) == 0 &&
+         header->block == JOB_BLOCK &&
+         header->stride == CACHE_STRIDE &&
+         header->capacity == CACHE_CAPACITY;
+}
+
+int cache_open(cache_t **cache, const char *path, const kernel_t *kernel, const kernel_mode_t *mode) {
+  struct stat st;
+  int error = 0;
+
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if(fd < 0) return errno;
+
+  // Only one process sets up a new file, the others wait for it here
+  if(flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0) {
+    error = errno;
+    close(fd);
+    return error;
+  }
+
+  if(st.st_size == 0 && ftruncate(fd, sizeof(cache_file_t)) < 0) {
+    error = errno;
+    close(fd);
+    return error;
+  }
+  if(st.st_size != 0 && st.st_size != sizeof(cache_file_t)) {
+    close(fd);
+    return CACHE_MISMATCH;
+  }
+
+  cache_file_t *file = mmap(NULL, sizeof(cache_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(file == MAP_FAILED) {
+    error = errno;
+    close(fd);
+    return error;
+  }
+
+  if(memcmp(file->header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+    write_header(&file->header, kernel, mode);
+  } else if(!check_header(&file->header, kernel, mode)) {
+    error = CACHE_MISMATCH;
+  }
+
+  // The mapping keeps the file open, so the lock has to be released explicitly
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  if(!error && !(*cache = malloc(sizeof(cache_t)))) error = ENOMEM;
+  if(error) {
+    munmap(file, sizeof(cache_file_t));
+    return error;
+  }
+
+  (*cache)->file = file;
+  (*cache)->mode = *mode;
+  atomic_init(&(*cache)->refs, 1);
+
+  return 0;
+}
+
+void cache_release(cache_t *cache) {
+  if(atomic_fetch_sub(&cache->refs, 1) != 1) return;
+
+  munmap(cache->file, sizeof(cache_file_t));
+  free(cache);
+}
+
+void cache_install(cache_t *cache) {
+  pthread_mutex_lock(&lock);
+  cache_t *previous = installed;
+  installed = cache;
+  pthread_mutex_unlock(&lock);
+
+  if(previous) cache_release(previous);
+}
+
+cache_t *cache_acquire(const kernel_mode_t *mode) {
+  pthread_mutex_lock(&lock);
+
+  cache_t *cache = installed;
+  if(cache && (cache->mode.type != mode->type || cache->mode.precision != mode->precision ||
+               cache->mode.steps != mode->steps)) {
+    cache = NULL;
+  }
+  if(cache) atomic_fetch_add(&cache->refs, 1);
+
+  pthread_mutex_unlock(&lock);
+
+  return cache;
+}
+
+size_t cache_lookup(cache_t *cache, size_t terms, dd_t *sum) {
+  uint64_t count = atomic_load_explicit(&cache->file->header.count, memory_order_acquire);
+  size_t index = terms / CACHE_STRIDE;
+
+  if(index > count) index = count;
+  if(index == 0) {
+    sum->hi = sum->lo = 0.0;
+    return 0;
+  }
+
+  *sum = cache->file->sums[index - 1];
+
+  return index * CACHE_STRIDE;
+}
+
+// Processes storing the same checkpoint write the same bits,
+// so only the count has to be updated atomically
+void cache_store(cache_t *cache, size_t terms, dd_t sum) {
+  _Atomic uint64_t *count = &cache->file->header.count;
+  uint64_t index = terms / CACHE_STRIDE;
+  uint64_t current = atomic_load_explicit(count, memory_order_acquire);
+
+  if(index != current + 1 || index > CACHE_CAPACITY) return;
+
+  cache->file->sums[index - 1] = sum;
+  while(current < index &&
+        !atomic_compare_exchange_weak_explicit(count, &current, index, memory_order_release, memory_order_acquire));
+}
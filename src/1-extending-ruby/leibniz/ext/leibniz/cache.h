@@ -0,0 +1,35 @@
+#ifndef LEIBNIZ_CACHE_H
+#define LEIBNIZ_CACHE_H
+
+#include "job.h"
+
+#define CACHE_VERSION 1
+// A checkpoint every 16 blocks, so a cached calc computes at most 2^24 terms
+#define CACHE_STRIDE (JOB_BLOCK * 16)
+// Checkpoints in a file, enough for n up to 2^40
+#define CACHE_CAPACITY ((size_t) 1 << 16)
+// cache_open error for a file created by another kernel, mode or version
+#define CACHE_MISMATCH (-1)
+
+// A file of the sums of the first k * CACHE_STRIDE terms, shared by every process
+// that maps it. The checkpoints are the job sums after whole blocks, so a job
+// resumed from one gives the same bits as a job computed from 0
+typedef struct cache cache_t;
+
+// Maps the file, creating it when it doesn't exist.
+// Returns 0, an errno value, or CACHE_MISMATCH
+int cache_open(cache_t **cache, const char *path, const kernel_t *kernel, const kernel_mode_t *mode);
+// Makes the cache the one used by cache_acquire, taking over the reference
+// from cache_open. The previous one is released, NULL just removes it
+void cache_install(cache_t *cache);
+// The installed cache when it's for the given mode, or NULL.
+// The caller gets a reference and must call cache_release
+cache_t *cache_acquire(const kernel_mode_t *mode);
+void cache_release(cache_t *cache);
+// The largest checkpoint up to terms, sets sum to its sum
+size_t cache_lookup(cache_t *cache, size_t terms, dd_t *sum);
+// Stores the sum of the first `terms` terms, a multiple of CACHE_STRIDE.
+// The checkpoints before it have to be stored already
+void cache_store(cache_t *cache, size_t terms, dd_t sum);
+
+#endif
@@ -0,0 +1,377 @@
+#include "leibniz.h"
+#include "bigint.h"
+#include <ruby/thread.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+
+// The largest number of digits Leibniz.digits computes, it takes a few GB of memory
+#define DIGITS_MAX 100000000
+// Extra digits computed to absorb the errors of the truncated divisions
+#define DIGITS_GUARD 20
+// Each term of the Chudnovsky series adds log10(640320^3 / 1728) digits
+#define DIGITS_PER_TERM 14.181647462725477
+
+// P, Q and T of a range of terms of the Chudnovsky series, where
+// pi = 426880 * sqrt(10005) * Q(0, n) / T(0, n)
+typedef struct {
+  bigint_t p, q, t;
+} split_t;
+
+typedef enum {
+  DIGITS_DONE,
+  DIGITS_STOPPED,
+  // An allocation failed, the bigints are invalid
+  DIGITS_NO_MEMORY
+} digits_status;
+
+typedef struct {
+  split_t *result;
+  size_t a, b;
+  unsigned depth;
+  int need_p;
+  atomic_int *stop;
+} split_task_t;
+
+typedef struct {
+  bigint_t *r;
+  const bigint_t *a, *b;
+} mul_task_t;
+
+static void split(split_t *r, size_t a, size_t b, unsigned depth, int need_p, atomic_int *stop);
+
+static void *split_thread(void *data) {
+  split_task_t *task = data;
+
+  split(task->result, task->a, task->b, task->depth, task->need_p, task->stop);
+
+  return NULL;
+}
+
+static void *mul_thread(void *data) {
+  mul_task_t *task = data;
+
+  bigint_mul(task->r, task->a, task->b);
+
+  return NULL;
+}
+
+// Computes the products at the same time, when there's a thread for each of them.
+// The last one runs in the current thread, as do those whose thread couldn't be created
+static void mul_all(mul_task_t *tasks, int count, int parallel) {
+  pthread_t threads[4];
+  int spawned[4] = { 0 };
+
+  for(int i = 0; parallel && i < count - 1; ++i) {
+    spawned[i] = pthread_create(&threads[i], NULL, mul_thread, &tasks[i]) == 0;
+  }
+
+  for(int i = 0; i < count; ++i) {
+    if(!spawned[i]) mul_thread(&tasks[i]);
+  }
+
+  for(int i = 0; i < count; ++i) {
+    if(spawned[i]) pthread_join(threads[i], NULL);
+  }
+}
+
+// Binary splitting of the terms in [a, b). The first `depth` levels of the tree
+// compute the left half in a new thread, so 2^depth threads share the work.
+// P isn't needed by the rightmost nodes, so they skip it.
+// When stop is set the nodes return right away, with meaningless values.
+// A node left invalid by an allocation failure sets it, the invalid values
+// reach the root through its parents, so the failure isn't lost
+static void split(split_t *r, size_t a, size_t b, unsigned depth, int need_p, atomic_int *stop) {
+  bigint_init(&r->p);
+  bigint_init(&r->q);
+  bigint_init(&r->t);
+  if(atomic_load_explicit(stop, memory_order_relaxed)) return;
+
+  if(b - a == 1) {
+    if(a == 0) {
+      bigint_set_u64(&r->p, 1);
+      bigint_set_u64(&r->q, 1);
+      bigint_set_u64(&r->t, 13591409);
+      return;
+    }
+
+    // P = (6a - 5)(2a - 1)(6a - 1) and Q = a^3 * 640320^3 / 24
+    bigint_t linear;
+    bigint_init(&linear);
+    bigint_set_u64(&r->p, (uint64_t) (6 * a - 5) * (2 * a - 1));
+    bigint_mul_small(&r->p, &r->p, (uint32_t) (6 * a - 1));
+    bigint_set_u64(&r->q, (uint64_t) a * a);
+    bigint_mul_small(&r->q, &r->q, (uint32_t) a);
+    bigint_mul_small(&r->q, &r->q, 640320);
+    bigint_mul_small(&r->q, &r->q, 640320);
+    bigint_mul_small(&r->q, &r->q, 26680);
+    bigint_set_u64(&linear, 13591409 + (uint64_t) 545140134 * a);
+    bigint_mul(&r->t, &r->p, &linear);
+    if(a & 1) r->t.negative = !r->t.negative;
+    bigint_free(&linear);
+    return;
+  }
+
+  size_t m = a + (b - a) / 2;
+  split_t left, right;
+  split_task_t task = { &left, a, m, depth ? depth - 1 : 0, 1, stop };
+  pthread_t thread;
+  int spawned = depth && pthread_create(&thread, NULL, split_thread, &task) == 0;
+
+  if(!spawned) split_thread(&task);
+  split(&right, m, b, depth ? depth - 1 : 0, need_p, stop);
+  if(spawned) pthread_join(thread, NULL);
+
+  // P = lP rP, Q = lQ rQ and T = rQ lT + lP rT
+  bigint_t t;
+  bigint_init(&t);
+  mul_task_t tasks[] = {
+    { &r->t, &right.q, &left.t },
+    { &t, &left.p, &right.t },
+    { &r->q, &left.q, &right.q },
+    { &r->p, &left.p, &right.p },
+  };
+  mul_all(tasks, need_p ? 4 : 3, depth > 0);
+  bigint_add(&r->t, &r->t, &t);
+
+  bigint_free(&t);
+  bigint_free(&left.p);
+  bigint_free(&left.q);
+  bigint_free(&left.t);
+  bigint_free(&right.p);
+  bigint_free(&right.q);
+  bigint_free(&right.t);
+
+  if(r->p.invalid || r->q.invalid || r->t.invalid) atomic_store(stop, 1);
+}
+
+static void set_power(bigint_t *r, size_t limbs) {
+  bigint_set_u64(r, 1);
+  bigint_shift(r, r, (ptrdiff_t) limbs);
+}
+
+// Sets r to a value of up to 128 bits
+static void set_u128(bigint_t *r, unsigned __int128 value) {
+  const uint64_t base = (uint64_t) BIGINT_BASE * BIGINT_BASE;
+  bigint_t low;
+
+  bigint_init(&low);
+  bigint_set_u64(r, (uint64_t) (value / base));
+  bigint_shift(r, r, 2);
+  bigint_set_u64(&low, (uint64_t) (value % base));
+  bigint_add(r, r, &low);
+  bigint_free(&low);
+}
+
+// r ~ BASE^(p + n) / b, where n is the number of limbs of b, with about p limbs of precision.
+// Newton's iteration r' = r + r (1 - b r), doubling the precision each step
+static void reciprocal(bigint_t *r, const bigint_t *b, size_t p) {
+  size_t n = b->size;
+
+  if(p <= 2) {
+    // b / BASE^n, from its first 3 limbs
+    long double top = 0.0L;
+    for(size_t i = 1; i <= 3; ++i) {
+      top = top * BIGINT_BASE + (i <= n ? b->limbs[n - i] : 0);
+    }
+    long double scaled = powl(BIGINT_BASE, (long double) (p + 3)) / top;
+    set_u128(r, (unsigned __int128) scaled);
+    return;
+  }
+
+  size_t h = p / 2 + 1;
+  bigint_t truncated, error, one;
+  bigint_init(&truncated);
+  bigint_init(&error);
+  bigint_init(&one);
+
+  reciprocal(r, b, h);
+  bigint_shift(r, r, (ptrdiff_t) (p - h));
+
+  // error = BASE^(2p + 2) - b r, with b scaled to p + 2 limbs
+  bigint_shift(&truncated, b, (ptrdiff_t) (p + 2) - (ptrdiff_t) n);
+  bigint_mul(&error, &truncated, r);
+  error.negative = !error.negative && error.size;
+  set_power(&one, 2 * p + 2);
+  bigint_add(&error, &error, &one);
+
+  bigint_shift(&error, &error, -(ptrdiff_t) p);
+  bigint_mul(&error, r, &error);
+  bigint_shift(&error, &error, -(ptrdiff_t) (p + 2));
+  bigint_add(r, r, &error);
+
+  bigint_free(&truncated);
+  bigint_free(&error);
+  bigint_free(&one);
+}
+
+// r ~ BASE^p / sqrt(a), with Newton's iteration r' = r + r (1 - a r^2) / 2
+static void rsqrt(bigint_t *r, uint32_t a, size_t p) {
+  if(p <= 2) {
+    bigint_set_u64(r, (uint64_t) (powl(BIGINT_BASE, (long double) p) / sqrtl(a)));
+    return;
+  }
+
+  size_t h = p / 2 + 1;
+  bigint_t error, one;
+  bigint_init(&error);
+  bigint_init(&one);
+
+  rsqrt(r, a, h);
+  bigint_shift(r, r, (ptrdiff_t) (p - h));
+
+  bigint_mul(&error, r, r);
+  bigint_mul_small(&error, &error, a);
+  error.negative = !error.negative && error.size;
+  set_power(&one, 2 * p);
+  bigint_add(&error, &error, &one);
+
+  bigint_shift(&error, &error, -(ptrdiff_t) p);
+  bigint_mul(&error, r, &error);
+  bigint_shift(&error, &error, -(ptrdiff_t) p);
+  bigint_div_small(&error, &error, 2);
+  bigint_add(r, r, &error);
+
+  bigint_free(&error);
+  bigint_free(&one);
+}
+
+// Sets result to "3." followed by the first count decimals of pi.
+// Only the binary splitting uses threads, the division and the square root
+// at the end take a few multiplications of the full size
+static digits_status compute_pi(size_t count, unsigned threads, atomic_int *stop, char **result) {
+  size_t terms = (size_t) ((double) count / DIGITS_PER_TERM) + 2;
+  size_t p = (count + DIGITS_GUARD) / BIGINT_DIGITS + 2;
+  unsigned depth = 0;
+  while((1u << depth) < threads) ++depth;
+
+  split_t sums;
+  split(&sums, 0, terms, depth, 0, stop);
+
+  bigint_t x, y;
+  bigint_init(&x);
+  bigint_init(&y);
+
+  // The failure comes first, it also stops the other threads
+  digits_status status = sums.q.invalid || sums.t.invalid ? DIGITS_NO_MEMORY :
+                         atomic_load(stop) ? DIGITS_STOPPED : DIGITS_DONE;
+  if(status == DIGITS_DONE) {
+    // Only the first p + 2 limbs of Q and T matter for Q / T
+    ptrdiff_t shift = (ptrdiff_t) (p + 2) - (ptrdiff_t) sums.t.size;
+    if(shift < 0) {
+      bigint_shift(&sums.q, &sums.q, shift);
+      bigint_shift(&sums.t, &sums.t, shift);
+    }
+
+    // x = BASE^p Q / T
+    reciprocal(&x, &sums.t, p);
+    bigint_mul(&x, &x, &sums.q);
+    bigint_shift(&x, &x, -(ptrdiff_t) sums.t.size);
+
+    // y = BASE^p sqrt(10005)
+    rsqrt(&y, 10005, p);
+    bigint_mul_small(&y, &y, 10005);
+
+    bigint_mul(&x, &x, &y);
+    bigint_shift(&x, &x, -(ptrdiff_t) p);
+    bigint_mul_small(&x, &x, 426880);
+  }
+
+  bigint_free(&sums.p);
+  bigint_free(&sums.q);
+  bigint_free(&sums.t);
+  bigint_free(&y);
+
+  // x is pi BASE^p, so its last limb is 3 and the others are the decimals
+  if(status == DIGITS_DONE && (x.invalid || !(*result = malloc(p * BIGINT_DIGITS + 3)))) {
+    status = DIGITS_NO_MEMORY;
+  }
+
+  if(status == DIGITS_DONE) {
+    char *position = *result + sprintf(*result, "%u.", x.limbs[p]);
+    for(size_t i = p; i-- > 0;) {
+      position += sprintf(position, "%08u", x.limbs[i]);
+    }
+    (*result)[count + 2] = '\0';
+  }
+  bigint_free(&x);
+
+  return status;
+}
+
+typedef struct {
+  size_t count;
+  unsigned threads;
+  atomic_int stop;
+  digits_status status;
+  char *result;
+} digits_run_t;
+
+static void *compute_without_gvl(void *data) {
+  digits_run_t *run = data;
+
+  run->status = compute_pi(run->count, run->threads, &run->stop, &run->result);
+
+  return NULL;
+}
+
+// Unblocking function, the threads check the flag between the nodes of the tree
+static void stop_digits(void *data) {
+  atomic_store(&((digits_run_t *) data)->stop, 1);
+}
+
+static ID digits_ids[1];
+
+// Leibniz.digits(count, threads: 1)
+// The first count decimals of pi as a String, "3.1415...".
+// Unlike calc, it's exact: the Chudnovsky series adds 14 digits each term,
+// and the terms are summed as integers with binary splitting.
+// The GVL is released, and the computation is restarted when an interrupt
+// doesn't raise, as it gives up everything when it's stopped.
+// Raises NoMemoryError when the numbers don't fit in memory
+static VALUE digits(int argc, VALUE *argv, VALUE self) {
+  VALUE times, opts, values[1];
+  digits_run_t run;
+
+  rb_scan_args(argc, argv, "1:", &times, &opts);
+  long count = NUM2LONG(times);
+  if(count < 1 || count > DIGITS_MAX) {
+    rb_raise(rb_eArgError, "count must be between 1 and %d", DIGITS_MAX);
+  }
+
+  run.count = (size_t) count;
+  run.threads = 1;
+  if(!NIL_P(opts)) {
+    rb_get_kwargs(opts, digits_ids, 0, 1, values);
+    if(values[0] != Qundef) {
+      int threads = NUM2INT(values[0]);
+      if(threads < 1 || threads > JOB_MAX_THREADS) {
+        rb_raise(rb_eArgError, "threads must be between 1 and %d", JOB_MAX_THREADS);
+      }
+      run.threads = (unsigned) threads;
+    }
+  }
+
+  for(;;) {
+    atomic_init(&run.stop, 0);
+    run.result = NULL;
+    run.status = DIGITS_STOPPED;
+    rb_thread_call_without_gvl(compute_without_gvl, &run, stop_digits, &run);
+    if(run.status == DIGITS_DONE) break;
+    if(run.status == DIGITS_NO_MEMORY) {
+      rb_raise(rb_eNoMemError, "not enough memory to compute %ld digits of pi", count);
+    }
+    rb_thread_check_ints();
+  }
+
+  VALUE result = rb_str_new(run.result, count + 2);
+  free(run.result);
+
+  return result;
+}
+
+void init_digits(VALUE super) {
+  digits_ids[0] = rb_intern("threads");
+
+  rb_define_singleton_method(super, "digits", digits, -1);
+}
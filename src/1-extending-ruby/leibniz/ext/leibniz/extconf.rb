@@ -1,3 +1,56 @@
 require 'mkmf'
 
-create_makefile 'leibniz/leibniz'
+have_library 'pthread'
+# Wakes up the waiters of Leibniz::Future, a pipe is used without it
+have_header 'sys/eventfd.h'
+
+# USDT probes, see ext/leibniz/probes.h, `ruby extconf.rb --disable-probes` compiles them out
+have_header 'sys/sdt.h' if enable_config('probes', true)
+
+# Leibniz.stats counters, `ruby extconf.rb --disable-stats` compiles them out
+$defs << '-DLEIBNIZ_NO_STATS' unless enable_config('stats', true)
+
+# Native benchmark built by `make bench`, see ext/leibniz/depend
+$cleanfiles << 'leibniz-bench'
+
+# The kernels are short loops bound by the latency of their accumulators, so where
+# they start in the instruction fetch window changed their speed by 10-20%
+$CFLAGS << ' -falign-loops=32' if try_cflags('-falign-loops=32')
+
+# Tuned builds, e.g. `ruby extconf.rb --with-pgo --with-lto --with-march=native`.
+# The flags are checked here, so an unsupported compiler fails now instead of in make
+def check_tuning_flags(option, *flags)
+  flags.each do |flag|
+    next if checking_for("whether #{flag} is accepted as CFLAGS") { try_cflags(flag) }
+
+    abort "--with-#{option} needs #{flag}, which #{RbConfig::CONFIG['CC']} doesn't support"
+  end
+  flags.join(' ')
+end
+
+# Only tunes the scalar code, the SIMD kernels are still picked at runtime
+if (march = with_config('march'))
+  abort '--with-march needs a value, e.g. --with-march=native' if march == true
+  $CFLAGS << ' ' << check_tuning_flags('march', "-march=#{march}")
+end
+
+if with_config('lto')
+  lto = check_tuning_flags('lto', try_cflags('-flto=auto') ? '-flto=auto' : '-flto')
+  $CFLAGS << ' ' << lto
+  $LDFLAGS << ' ' << lto
+end
+
+# The profile is collected by make, see ext/leibniz/depend.
+# Only GCC's flags are supported, clang needs llvm-profdata to merge its profiles
+pgo = with_config('pgo')
+if pgo
+  check_tuning_flags 'pgo', '-fprofile-generate', '-fprofile-update=prefer-atomic', '-fprofile-partial-training'
+  $CFLAGS << ' $(PGO_CFLAGS)'
+  $LDFLAGS << ' $(PGO_CFLAGS)'
+  $distcleanfiles << 'pgo-profile/*.gcda' << 'pgo-profile/.trained'
+  $distcleandirs << 'pgo-profile'
+end
+
+create_makefile 'leibniz/leibniz' do |conf|
+  conf << "PGO = #{pgo ? 'use' : ''}\n"
+end
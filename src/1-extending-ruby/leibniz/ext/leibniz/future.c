@@ -0,0 +1,146 @@
+#include "leibniz.h"
+#include "pool.h"
+#include <ruby/io.h>
+#include <fcntl.h>
+
+// Result of Leibniz.calc_async, computed by the native worker pool
+typedef struct {
+  pool_task_t *task;
+  // IO on the task's fd, created by the first wait
+  VALUE io;
+} future_t;
+
+static void future_mark(void *data) {
+  rb_gc_mark(((future_t *) data)->io);
+}
+
+// When the future is collected the result isn't needed anymore,
+// so the job is stopped and the pool lets go of it
+static void future_free(void *data) {
+  future_t *future = data;
+
+  if(future->task) {
+    job_stop(&future->task->job);
+    pool_task_release(future->task);
+  }
+  xfree(future);
+}
+
+static size_t future_size(const void *data) {
+  return sizeof(future_t) + (((const future_t *) data)->task ? sizeof(pool_task_t) : 0);
+}
+
+static const rb_data_type_t future_type = {
+  .wrap_struct_name = "Leibniz::Future",
+  .function = {
+    .dmark = future_mark,
+    .dfree = future_free,
+    .dsize = future_size,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE futureClass;
+
+static VALUE future_alloc(VALUE klass) {
+  future_t *future;
+  VALUE self = TypedData_Make_Struct(klass, future_t, &future_type, future);
+  future->io = Qnil;
+
+  return self;
+}
+
+static future_t *get_future(VALUE self) {
+  future_t *future;
+  TypedData_Get_Struct(self, future_t, &future_type, future);
+  if(!future->task) rb_raise(rb_eTypeError, "uninitialized future");
+
+  return future;
+}
+
+static int is_ready(const future_t *future) {
+  int state = atomic_load(&future->task->state);
+
+  return state == POOL_FINISHED || state == POOL_LOST;
+}
+
+// Leibniz.calc_async(n, **options), takes the same options as calc
+// Queues the computation on the worker pool and returns a Leibniz::Future right away.
+// The threads: option is the number of threads of the job, not of the pool
+static VALUE calc_async(int argc, VALUE *argv, VALUE self) {
+  VALUE times, opts;
+  calc_options options;
+
+  rb_scan_args(argc, argv, "1:", &times, &opts);
+  size_t n = num2terms(times);
+  parse_options(opts, &options);
+
+  VALUE result = future_alloc(futureClass);
+  future_t *future = DATA_PTR(result);
+
+  pool_task_t *task = pool_task_new();
+  if(!task) rb_sys_fail("calc_async");
+  rb_update_max_fd(task->fd);
+  rb_update_max_fd(task->notify_fd);
+  future->task = task;
+
+  prepare_job(&task->job, 0, n, &options);
+  int error = pool_submit(task);
+  if(error) rb_syserr_fail(error, "calc_async");
+
+  return result;
+}
+
+// Leibniz::Future#to_io, becomes readable once the result is ready,
+// so it can be passed to IO.select or an event loop.
+// The fd belongs to the future, so the IO is only valid while the future is
+static VALUE future_to_io(VALUE self) {
+  future_t *future = get_future(self);
+
+  if(NIL_P(future->io)) {
+    VALUE io = rb_io_fdopen(future->task->fd, O_RDONLY, NULL);
+    rb_funcall(io, rb_intern("autoclose="), 1, Qfalse);
+    RB_OBJ_WRITE(self, &future->io, io);
+  }
+
+  return future->io;
+}
+
+static VALUE future_ready(VALUE self) {
+  return is_ready(get_future(self)) ? Qtrue : Qfalse;
+}
+
+// Leibniz::Future#value, waits for the result and returns the estimate of pi.
+// The wait goes through IO#wait_readable, so with a Fiber::Scheduler only
+// the fiber waits, and without one the thread waits without the GVL.
+// Raises Leibniz::TimeoutError when a timeout: was given and it expired
+static VALUE future_value(VALUE self) {
+  future_t *future = get_future(self);
+
+  while(!is_ready(future)) {
+    rb_io_wait(future_to_io(self), RB_INT2NUM(RUBY_IO_READABLE), Qnil);
+  }
+
+  job_t *job = &future->task->job;
+
+  if(atomic_load(&future->task->state) == POOL_LOST) {
+    rb_raise(rb_eRuntimeError, "the computation was lost when the process forked");
+  }
+  if(atomic_load(&job->status) == JOB_EXPIRED) {
+    raise_timeout(job->done, job->to - job->from, job_sum(job) * 4.0, job->done);
+  }
+
+  return rb_float_new(job_sum(job) * 4.0);
+}
+
+VALUE init_future(VALUE super) {
+  futureClass = rb_define_class_under(super, "Future", rb_cObject);
+  rb_undef_alloc_func(futureClass);
+  rb_define_method(futureClass, "value", future_value, 0);
+  rb_define_method(futureClass, "ready?", future_ready, 0);
+  rb_define_method(futureClass, "to_io", future_to_io, 0);
+
+  rb_define_singleton_method(super, "calc_async", calc_async, -1);
+
+  return futureClass;
+}
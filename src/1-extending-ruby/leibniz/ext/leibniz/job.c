@@ -0,0 +1,136 @@
+#include <pthread.h>
+#include <time.h>
+#include "job.h"
+
+// A window of blocks shared by the threads of a job
+typedef struct {
+  job_t *job;
+  size_t first;
+  size_t count;
+  atomic_size_t next;
+  dd_t sums[JOB_WINDOW];
+  unsigned char finished[JOB_WINDOW];
+} window_t;
+
+void job_init(job_t *job, const kernel_t *kernel, size_t from, size_t to, unsigned threads) {
+  job->kernel = kernel;
+  job->mode.type = TYPE_DOUBLE;
+  job->mode.precision = PRECISION_EXACT;
+  job->mode.steps = KERNEL_DEFAULT_STEPS;
+  job->series = NULL;
+  job->from = from;
+  job->to = to < from ? from : to;
+  job->threads = threads < 1 ? 1 : threads > JOB_MAX_THREADS ? JOB_MAX_THREADS : threads;
+  job->deadline = 0.0;
+  atomic_init(&job->status, JOB_RUNNING);
+  job->sum.hi = 0.0;
+  job->sum.lo = 0.0;
+  job->done = 0;
+  job->checkpoint = NULL;
+  job->checkpoint_data = NULL;
+}
+
+double job_sum(const job_t *job) {
+  return job->sum.hi + job->sum.lo;
+}
+
+double job_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+void job_extend(job_t *job, size_t to) {
+  int done = JOB_DONE;
+
+  if(to <= job->to) return;
+  job->to = to;
+  atomic_compare_exchange_strong(&job->status, &done, JOB_RUNNING);
+}
+
+void job_stop(job_t *job) {
+  int running = JOB_RUNNING;
+  atomic_compare_exchange_strong(&job->status, &running, JOB_STOPPED);
+}
+
+void job_resume(job_t *job) {
+  int stopped = JOB_STOPPED;
+  atomic_compare_exchange_strong(&job->status, &stopped, JOB_RUNNING);
+}
+
+// Each thread keeps taking the next block of the window until there's none left,
+// or until the job is stopped
+static void *work(void *data) {
+  window_t *window = data;
+  job_t *job = window->job;
+  size_t i;
+
+  while(atomic_load_explicit(&job->status, memory_order_relaxed) == JOB_RUNNING &&
+        (i = atomic_fetch_add(&window->next, 1)) < window->count) {
+    size_t from = job->from + (window->first + i) * JOB_BLOCK;
+    size_t to = job->to - from > JOB_BLOCK ? from + JOB_BLOCK : job->to;
+
+    window->sums[i] = job->series ? kernel_sum_series(job->kernel, job->series, from, to)
+                                  : kernel_sum(job->kernel, &job->mode, from, to);
+    window->finished[i] = 1;
+
+    if(job->deadline > 0.0 && job_clock() >= job->deadline) {
+      int running = JOB_RUNNING;
+      atomic_compare_exchange_strong(&job->status, &running, JOB_EXPIRED);
+    }
+  }
+
+  return NULL;
+}
+
+job_status job_run(job_t *job) {
+  window_t window;
+  pthread_t threads[JOB_MAX_THREADS];
+
+  window.job = job;
+
+  while(job->from + job->done < job->to) {
+    int status = atomic_load(&job->status);
+    if(status != JOB_RUNNING) return status;
+
+    size_t remaining = job->to - job->from - job->done;
+    size_t blocks = remaining / JOB_BLOCK + (remaining % JOB_BLOCK != 0);
+
+    window.first = job->done / JOB_BLOCK;
+    window.count = blocks < JOB_WINDOW ? blocks : JOB_WINDOW;
+    atomic_init(&window.next, 0);
+    for(size_t i = 0; i < window.count; ++i) {
+      window.finished[i] = 0;
+    }
+
+    // The calling thread works too, so only threads - 1 are created.
+    // If a thread can't be created, the others take its blocks
+    unsigned spawn = job->threads < window.count ? job->threads - 1 : window.count - 1;
+    unsigned spawned = 0;
+    for(; spawned < spawn; ++spawned) {
+      if(pthread_create(&threads[spawned], NULL, work, &window) != 0) break;
+    }
+
+    work(&window);
+
+    for(unsigned i = 0; i < spawned; ++i) {
+      pthread_join(threads[i], NULL);
+    }
+
+    // Only the blocks before the first unfinished one are added,
+    // so the sum always covers a contiguous range
+    for(size_t i = 0; i < window.count && window.finished[i]; ++i) {
+      size_t terms = remaining < JOB_BLOCK ? remaining : JOB_BLOCK;
+
+      job->sum = kernel_add(&job->mode, job->sum, window.sums[i]);
+      job->done += terms;
+      remaining -= terms;
+      if(job->checkpoint) job->checkpoint(job, job->checkpoint_data);
+    }
+  }
+
+  atomic_store(&job->status, JOB_DONE);
+
+  return JOB_DONE;
+}
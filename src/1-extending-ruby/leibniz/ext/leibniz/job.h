@@ -0,0 +1,60 @@
+#ifndef LEIBNIZ_JOB_H
+#define LEIBNIZ_JOB_H
+
+#include <stdatomic.h>
+#include "kernel.h"
+
+// The range is split into blocks of JOB_BLOCK terms, and the block sums are
+// always added in the same order. That way the result doesn't depend
+// on how many threads computed the blocks
+#define JOB_BLOCK ((size_t) 1 << 20)
+// How many blocks are computed between each reduction
+#define JOB_WINDOW 256
+#define JOB_MAX_THREADS 256
+
+typedef enum {
+  JOB_RUNNING,
+  JOB_DONE,
+  // Stopped by job_stop, job_run can be called again to resume it
+  JOB_STOPPED,
+  // The deadline has passed
+  JOB_EXPIRED
+} job_status;
+
+typedef struct job {
+  const kernel_t *kernel;
+  kernel_mode_t mode;
+  // Another series to sum instead of Leibniz, NULL by default
+  const series_t *series;
+  size_t from;
+  size_t to;
+  unsigned threads;
+  // Seconds on the job_clock, or 0 when there's no deadline
+  double deadline;
+  atomic_int status;
+  // Sum of the terms in [from, from + done), lo is only used by TYPE_DOUBLE_DOUBLE
+  dd_t sum;
+  size_t done;
+  // Called by job_run in its own thread after each block is added to sum, NULL by default
+  void (*checkpoint)(const struct job *job, void *data);
+  void *checkpoint_data;
+} job_t;
+
+void job_init(job_t *job, const kernel_t *kernel, size_t from, size_t to, unsigned threads);
+// Computes the remaining terms of the job, it doesn't touch the Ruby VM,
+// so it can be called without the GVL.
+// The threads only check if the job was stopped between blocks,
+// so a stopped job keeps every block that was fully computed
+job_status job_run(job_t *job);
+// The sum of the computed terms as a double
+double job_sum(const job_t *job);
+// Moves the end of the job forward, so a finished job can continue
+void job_extend(job_t *job, size_t to);
+// Asks a running job to stop, it can be called from any thread
+void job_stop(job_t *job);
+// Lets a stopped job run again
+void job_resume(job_t *job);
+// Monotonic clock in seconds, used for the deadlines
+double job_clock(void);
+
+#endif
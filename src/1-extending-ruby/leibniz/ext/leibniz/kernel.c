@@ -0,0 +1,908 @@
+#include <math.h>
+#include <stdint.h>
+#include "kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+// Without -mfma, fma() is a call into libm that spills every register of the loop.
+// The double-double scalar kernels get a clone that inlines it, picked at load time
+#ifdef KERNEL_X86
+#define KERNEL_FMA_CLONES __attribute__((target_clones("fma", "default")))
+#else
+#define KERNEL_FMA_CLONES
+#endif
+
+// Up to this index the denominators 2i + 1 are below 2^53, so they're exact as doubles.
+// After it, the kernels build them from wide_start and round each one once
+#define KERNEL_EXACT_INDEX ((size_t) 1 << 52)
+
+// The first index in [from, to) that's past KERNEL_EXACT_INDEX, or to
+static inline size_t exact_end(size_t from, size_t to) {
+  if(to <= KERNEL_EXACT_INDEX) return to;
+
+  return from > KERNEL_EXACT_INDEX ? from : KERNEL_EXACT_INDEX;
+}
+
+// Past KERNEL_EXACT_INDEX, the first denominator 2 * from + 1 of a range is split
+// into the double nearest to it and the exact rest, from its low and high 32 bits.
+// The next ones are start.hi + (start.lo + 2k), where the offsets are exact doubles,
+// so adding them rounds each denominator once, as converting the 64 bit integer would,
+// with a single addition. The offsets are exact below 2^53, so the kernels take
+// a new start every KERNEL_WIDE_CHUNK terms
+#define KERNEL_WIDE_CHUNK ((size_t) 1 << 32)
+
+static inline dd_t wide_start(size_t from) {
+  uint64_t den = 2 * (uint64_t) from + 1;
+  double high = (double) (den >> 32) * 4294967296.0;
+  double low = (double) (den & 0xffffffff);
+  dd_t start;
+
+  // high is at least 2^52, so it's larger than low and the rest is exact
+  start.hi = high + low;
+  start.lo = low - (start.hi - high);
+
+  return start;
+}
+
+// The end of the chunk of the wide range that starts at chunk
+static inline size_t wide_chunk_end(size_t chunk, size_t end) {
+  return end - chunk > KERNEL_WIDE_CHUNK ? chunk + KERNEL_WIDE_CHUNK : end;
+}
+
+// Same loop as the original calc, but starting at any index.
+// The signal is flipped before being used, so it starts inverted.
+// The denominators are counted as doubles instead of converting
+// the index on every iteration, past KERNEL_EXACT_INDEX as offsets of wide_start
+static double sum_scalar(size_t from, size_t to) {
+  double pi = 0.0;
+  double signal = (from & 1) ? 1.0 : -1.0;
+  double den = 2.0 * (double) from + 1.0;
+  size_t end = exact_end(from, to);
+  size_t i = from;
+
+  for(; i < end; ++i) {
+    signal = -signal;
+    pi += signal / den;
+    den += 2.0;
+  }
+
+  for(size_t chunk = i; chunk < to; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, to);
+    dd_t start = wide_start(chunk);
+    double offset = start.lo;
+
+    for(; i < chunk_end; ++i) {
+      signal = -signal;
+      pi += signal / (start.hi + offset);
+      offset += 2.0;
+    }
+  }
+
+  return pi;
+}
+
+// The float32 kernels sum the terms as floats in blocks of FLOAT32_BLOCK terms,
+// and add each block to a double. That way the rounding errors of the floats
+// only grow with the block size, instead of the number of terms.
+// The denominators are computed as start + 2 * offset, where start is the first
+// denominator of the block, so the offsets are always exact in a float
+#define FLOAT32_BLOCK 4096
+
+static double sum_scalar_float32(size_t from, size_t to) {
+  double pi = 0.0;
+
+  for(size_t block = from; block < to; block += FLOAT32_BLOCK) {
+    size_t block_end = to - block > FLOAT32_BLOCK ? block + FLOAT32_BLOCK : to;
+    float start = (float) (2.0 * (double) block + 1.0);
+    float signal = (block & 1) ? 1.0f : -1.0f;
+    float partial = 0.0f;
+
+    for(size_t i = block; i < block_end; ++i) {
+      signal = -signal;
+      partial += signal / (start + 2.0f * (float) (i - block));
+    }
+
+    pi += partial;
+  }
+
+  return pi;
+}
+
+// Error free transformation, hi + lo is exactly a + b
+static inline dd_t two_sum(double a, double b) {
+  dd_t r;
+  double bb;
+
+  r.hi = a + b;
+  bb = r.hi - a;
+  r.lo = (a - (r.hi - bb)) + (b - bb);
+
+  return r;
+}
+
+// Same, but only when |a| >= |b|
+static inline dd_t fast_two_sum(double a, double b) {
+  dd_t r;
+
+  r.hi = a + b;
+  r.lo = b - (r.hi - a);
+
+  return r;
+}
+
+static inline dd_t dd_add(dd_t a, dd_t b) {
+  dd_t s = two_sum(a.hi, b.hi);
+
+  return fast_two_sum(s.hi, s.lo + (a.lo + b.lo));
+}
+
+// Past KERNEL_EXACT_INDEX, the denominator is the double-double den.hi + den.lo,
+// the rounded sum of wide_start and the offset and its exact error,
+// and q * den.lo is taken out of the remainder. That product is as small as
+// the remainder, so it doesn't need a second FMA.
+// It's a separate function so the loop of sum_scalar_dd keeps its registers
+KERNEL_FMA_CLONES __attribute__((noinline))
+static dd_t sum_scalar_dd_wide(size_t from, size_t to) {
+  dd_t pi = { 0.0, 0.0 };
+  double signal = (from & 1) ? 1.0 : -1.0;
+
+  for(size_t chunk = from; chunk < to; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, to);
+    dd_t start = wide_start(chunk);
+    double offset = start.lo;
+
+    for(size_t i = chunk; i < chunk_end; ++i) {
+      signal = -signal;
+
+      dd_t den = fast_two_sum(start.hi, offset);
+      double q = signal / den.hi;
+      double r = fma(-q, den.hi, signal) - q * den.lo;
+      dd_t s = two_sum(pi.hi, q);
+
+      pi.hi = s.hi;
+      pi.lo += s.lo + r * q * signal;
+      offset += 2.0;
+    }
+  }
+
+  return fast_two_sum(pi.hi, pi.lo);
+}
+
+// Each term is split into q = signal / d, and the remainder of the division,
+// signal - q * d, which is exact with an FMA, divided by d.
+// Since the signal is 1 or -1, 1 / d is q * signal and the second division is a multiplication
+KERNEL_FMA_CLONES
+static dd_t sum_scalar_dd(size_t from, size_t to) {
+  dd_t pi = { 0.0, 0.0 };
+  double signal = (from & 1) ? 1.0 : -1.0;
+  size_t end = exact_end(from, to);
+
+  for(size_t i = from; i < end; ++i) {
+    signal = -signal;
+
+    double den = (double) (2 * i + 1);
+    double q = signal / den;
+    double r = fma(-q, den, signal);
+    dd_t s = two_sum(pi.hi, q);
+
+    pi.hi = s.hi;
+    pi.lo += s.lo + r * q * signal;
+  }
+
+  pi = fast_two_sum(pi.hi, pi.lo);
+
+  return end < to ? dd_add(pi, sum_scalar_dd_wide(end, to)) : pi;
+}
+
+#ifdef KERNEL_X86
+// The SIMD kernels are compiled with a target attribute instead of
+// a global -m flag, so a single .so can run on every x86_64 CPU.
+// Each lane handles the index (from + lane), since every iteration
+// advances the index by an even number of terms, the signals never change.
+// Whatever doesn't fit in a full vector is handled by sum_scalar.
+//
+// Up to KERNEL_EXACT_INDEX the loops count the denominators as doubles.
+// The full vectors after it are summed by the _wide functions, which add the offsets
+// of each lane to wide_start, so the denominators are still rounded only once.
+// The _wide functions aren't inlined, so they don't change the loops before them
+
+// The first full vector past KERNEL_EXACT_INDEX, so [exact, end) is made of full vectors
+static inline size_t exact_vectors_end(size_t from, size_t end, size_t lanes) {
+  return from + ((exact_end(from, end) - from) & ~(lanes - 1));
+}
+
+__attribute__((target("sse2"), noinline))
+static double sum_sse2_wide(size_t from, size_t end) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m128d signal_vector = _mm_setr_pd(first, -first);
+  __m128d step_vector = _mm_set1_pd(4.0);
+  __m128d result_vector = _mm_setzero_pd();
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m128d start_vector = _mm_set1_pd(start.hi);
+    __m128d offset_vector = _mm_add_pd(_mm_set1_pd(start.lo), _mm_setr_pd(0.0, 2.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 2) {
+      __m128d den_vector = _mm_add_pd(start_vector, offset_vector);
+
+      result_vector = _mm_add_pd(result_vector, _mm_div_pd(signal_vector, den_vector));
+      offset_vector = _mm_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  double temp[2];
+  _mm_storeu_pd(temp, result_vector);
+
+  return temp[0] + temp[1];
+}
+
+__attribute__((target("sse2")))
+static double sum_sse2(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 1);
+  size_t exact = exact_vectors_end(from, end, 2);
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m128d signal_vector = _mm_setr_pd(first, -first);
+  __m128d one_vector = _mm_set1_pd(1.0);
+  __m128d two_vector = _mm_set1_pd(2.0);
+  __m128d step_vector = _mm_set1_pd(2.0);
+  __m128d result_vector = _mm_setzero_pd();
+  __m128d sum_vector;
+  __m128d idx_vector = _mm_setr_pd((double) from, (double) from + 1.0);
+
+  for(size_t i = from; i < exact; i += 2) {
+    sum_vector = _mm_add_pd(_mm_mul_pd(two_vector, idx_vector), one_vector);
+    sum_vector = _mm_div_pd(signal_vector, sum_vector);
+
+    result_vector = _mm_add_pd(result_vector, sum_vector);
+    idx_vector = _mm_add_pd(idx_vector, step_vector);
+  }
+
+  double temp[2];
+  _mm_storeu_pd(temp, result_vector);
+  double pi = temp[0] + temp[1];
+  if(exact < end) pi += sum_sse2_wide(exact, end);
+
+  return pi + sum_scalar(end, to);
+}
+
+__attribute__((target("avx2,fma"), noinline))
+static double sum_avx2_wide(size_t from, size_t end) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m256d signal_vector = _mm256_setr_pd(first, -first, first, -first);
+  __m256d step_vector = _mm256_set1_pd(8.0);
+  __m256d result_vector = _mm256_setzero_pd();
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m256d start_vector = _mm256_set1_pd(start.hi);
+    __m256d offset_vector = _mm256_add_pd(_mm256_set1_pd(start.lo), _mm256_setr_pd(0.0, 2.0, 4.0, 6.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 4) {
+      __m256d den_vector = _mm256_add_pd(start_vector, offset_vector);
+
+      result_vector = _mm256_add_pd(result_vector, _mm256_div_pd(signal_vector, den_vector));
+      offset_vector = _mm256_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  double temp[4];
+  _mm256_storeu_pd(temp, result_vector);
+
+  return (temp[0] + temp[1]) + (temp[2] + temp[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static double sum_avx2(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 3);
+  size_t exact = exact_vectors_end(from, end, 4);
+  double first = (from & 1) ? -1.0 : 1.0;
+  double base = (double) from;
+
+  __m256d signal_vector = _mm256_setr_pd(first, -first, first, -first);
+  __m256d one_vector = _mm256_set1_pd(1.0);
+  __m256d two_vector = _mm256_set1_pd(2.0);
+  __m256d four_vector = _mm256_set1_pd(4.0);
+  __m256d result_vector = _mm256_setzero_pd();
+  __m256d sum_vector;
+  __m256d idx_vector = _mm256_setr_pd(base, base + 1.0, base + 2.0, base + 3.0);
+
+  for(size_t i = from; i < exact; i += 4) {
+    sum_vector = _mm256_fmadd_pd(two_vector, idx_vector, one_vector);
+    sum_vector = _mm256_div_pd(signal_vector, sum_vector);
+
+    result_vector = _mm256_add_pd(result_vector, sum_vector);
+    idx_vector = _mm256_add_pd(idx_vector, four_vector);
+  }
+
+  double temp[4];
+  _mm256_storeu_pd(temp, result_vector);
+  double pi = (temp[0] + temp[1]) + (temp[2] + temp[3]);
+  if(exact < end) pi += sum_avx2_wide(exact, end);
+
+  return pi + sum_scalar(end, to);
+}
+
+__attribute__((target("avx512f"), noinline))
+static double sum_avx512_wide(size_t from, size_t end) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m512d signal_vector = _mm512_setr_pd(first, -first, first, -first,
+                                         first, -first, first, -first);
+  __m512d step_vector = _mm512_set1_pd(16.0);
+  __m512d result_vector = _mm512_setzero_pd();
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m512d start_vector = _mm512_set1_pd(start.hi);
+    __m512d offset_vector = _mm512_add_pd(_mm512_set1_pd(start.lo),
+                                          _mm512_setr_pd(0.0, 2.0, 4.0, 6.0, 8.0, 10.0, 12.0, 14.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 8) {
+      __m512d den_vector = _mm512_add_pd(start_vector, offset_vector);
+
+      result_vector = _mm512_add_pd(result_vector, _mm512_div_pd(signal_vector, den_vector));
+      offset_vector = _mm512_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  return _mm512_reduce_add_pd(result_vector);
+}
+
+__attribute__((target("avx512f")))
+static double sum_avx512(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 7);
+  size_t exact = exact_vectors_end(from, end, 8);
+  double first = (from & 1) ? -1.0 : 1.0;
+  double base = (double) from;
+
+  __m512d signal_vector = _mm512_setr_pd(first, -first, first, -first,
+                                         first, -first, first, -first);
+  __m512d one_vector = _mm512_set1_pd(1.0);
+  __m512d two_vector = _mm512_set1_pd(2.0);
+  __m512d eight_vector = _mm512_set1_pd(8.0);
+  __m512d result_vector = _mm512_setzero_pd();
+  __m512d sum_vector;
+  __m512d idx_vector = _mm512_setr_pd(base, base + 1.0, base + 2.0, base + 3.0,
+                                      base + 4.0, base + 5.0, base + 6.0, base + 7.0);
+
+  for(size_t i = from; i < exact; i += 8) {
+    sum_vector = _mm512_fmadd_pd(two_vector, idx_vector, one_vector);
+    sum_vector = _mm512_div_pd(signal_vector, sum_vector);
+
+    result_vector = _mm512_add_pd(result_vector, sum_vector);
+    idx_vector = _mm512_add_pd(idx_vector, eight_vector);
+  }
+
+  double pi = _mm512_reduce_add_pd(result_vector);
+  if(exact < end) pi += sum_avx512_wide(exact, end);
+
+  return pi + sum_scalar(end, to);
+}
+
+// The fast kernels start from the reciprocal estimate of the denominators,
+// around 12 bits (14 bits for rcp14 on AVX-512), and each Newton-Raphson step
+//   x = x + x * (1 - d * x)
+// doubles the number of correct bits, until it reaches the double precision.
+// There's no fast SSE2 kernel, without FMA the steps cost more than the divisions
+
+__attribute__((target("avx2,fma"), noinline))
+static double sum_avx2_fast_wide(size_t from, size_t end, int steps) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m256d signal_vector = _mm256_setr_pd(first, -first, first, -first);
+  __m256d one_vector = _mm256_set1_pd(1.0);
+  __m256d step_vector = _mm256_set1_pd(8.0);
+  __m256d result_vector = _mm256_setzero_pd();
+  __m256d den_vector, rcp_vector, error_vector;
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m256d start_vector = _mm256_set1_pd(start.hi);
+    __m256d offset_vector = _mm256_add_pd(_mm256_set1_pd(start.lo), _mm256_setr_pd(0.0, 2.0, 4.0, 6.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 4) {
+      den_vector = _mm256_add_pd(start_vector, offset_vector);
+      rcp_vector = _mm256_cvtps_pd(_mm_rcp_ps(_mm256_cvtpd_ps(den_vector)));
+
+      for(int s = 0; s < steps; ++s) {
+        error_vector = _mm256_fnmadd_pd(den_vector, rcp_vector, one_vector);
+        rcp_vector = _mm256_fmadd_pd(rcp_vector, error_vector, rcp_vector);
+      }
+
+      result_vector = _mm256_fmadd_pd(signal_vector, rcp_vector, result_vector);
+      offset_vector = _mm256_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  double temp[4];
+  _mm256_storeu_pd(temp, result_vector);
+
+  return (temp[0] + temp[1]) + (temp[2] + temp[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static double sum_avx2_fast(size_t from, size_t to, int steps) {
+  size_t end = from + ((to - from) & ~(size_t) 3);
+  size_t exact = exact_vectors_end(from, end, 4);
+  double first = (from & 1) ? -1.0 : 1.0;
+  double base = (double) from;
+
+  __m256d signal_vector = _mm256_setr_pd(first, -first, first, -first);
+  __m256d one_vector = _mm256_set1_pd(1.0);
+  __m256d two_vector = _mm256_set1_pd(2.0);
+  __m256d four_vector = _mm256_set1_pd(4.0);
+  __m256d result_vector = _mm256_setzero_pd();
+  __m256d den_vector, rcp_vector, error_vector;
+  __m256d idx_vector = _mm256_setr_pd(base, base + 1.0, base + 2.0, base + 3.0);
+
+  for(size_t i = from; i < exact; i += 4) {
+    den_vector = _mm256_fmadd_pd(two_vector, idx_vector, one_vector);
+    rcp_vector = _mm256_cvtps_pd(_mm_rcp_ps(_mm256_cvtpd_ps(den_vector)));
+
+    for(int s = 0; s < steps; ++s) {
+      error_vector = _mm256_fnmadd_pd(den_vector, rcp_vector, one_vector);
+      rcp_vector = _mm256_fmadd_pd(rcp_vector, error_vector, rcp_vector);
+    }
+
+    result_vector = _mm256_fmadd_pd(signal_vector, rcp_vector, result_vector);
+    idx_vector = _mm256_add_pd(idx_vector, four_vector);
+  }
+
+  double temp[4];
+  _mm256_storeu_pd(temp, result_vector);
+  double pi = (temp[0] + temp[1]) + (temp[2] + temp[3]);
+  if(exact < end) pi += sum_avx2_fast_wide(exact, end, steps);
+
+  return pi + sum_scalar(end, to);
+}
+
+__attribute__((target("avx512f"), noinline))
+static double sum_avx512_fast_wide(size_t from, size_t end, int steps) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m512d signal_vector = _mm512_setr_pd(first, -first, first, -first,
+                                         first, -first, first, -first);
+  __m512d one_vector = _mm512_set1_pd(1.0);
+  __m512d step_vector = _mm512_set1_pd(16.0);
+  __m512d result_vector = _mm512_setzero_pd();
+  __m512d den_vector, rcp_vector, error_vector;
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m512d start_vector = _mm512_set1_pd(start.hi);
+    __m512d offset_vector = _mm512_add_pd(_mm512_set1_pd(start.lo),
+                                          _mm512_setr_pd(0.0, 2.0, 4.0, 6.0, 8.0, 10.0, 12.0, 14.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 8) {
+      den_vector = _mm512_add_pd(start_vector, offset_vector);
+      rcp_vector = _mm512_rcp14_pd(den_vector);
+
+      for(int s = 0; s < steps; ++s) {
+        error_vector = _mm512_fnmadd_pd(den_vector, rcp_vector, one_vector);
+        rcp_vector = _mm512_fmadd_pd(rcp_vector, error_vector, rcp_vector);
+      }
+
+      result_vector = _mm512_fmadd_pd(signal_vector, rcp_vector, result_vector);
+      offset_vector = _mm512_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  return _mm512_reduce_add_pd(result_vector);
+}
+
+__attribute__((target("avx512f")))
+static double sum_avx512_fast(size_t from, size_t to, int steps) {
+  size_t end = from + ((to - from) & ~(size_t) 7);
+  size_t exact = exact_vectors_end(from, end, 8);
+  double first = (from & 1) ? -1.0 : 1.0;
+  double base = (double) from;
+
+  __m512d signal_vector = _mm512_setr_pd(first, -first, first, -first,
+                                         first, -first, first, -first);
+  __m512d one_vector = _mm512_set1_pd(1.0);
+  __m512d two_vector = _mm512_set1_pd(2.0);
+  __m512d eight_vector = _mm512_set1_pd(8.0);
+  __m512d result_vector = _mm512_setzero_pd();
+  __m512d den_vector, rcp_vector, error_vector;
+  __m512d idx_vector = _mm512_setr_pd(base, base + 1.0, base + 2.0, base + 3.0,
+                                      base + 4.0, base + 5.0, base + 6.0, base + 7.0);
+
+  for(size_t i = from; i < exact; i += 8) {
+    den_vector = _mm512_fmadd_pd(two_vector, idx_vector, one_vector);
+    rcp_vector = _mm512_rcp14_pd(den_vector);
+
+    for(int s = 0; s < steps; ++s) {
+      error_vector = _mm512_fnmadd_pd(den_vector, rcp_vector, one_vector);
+      rcp_vector = _mm512_fmadd_pd(rcp_vector, error_vector, rcp_vector);
+    }
+
+    result_vector = _mm512_fmadd_pd(signal_vector, rcp_vector, result_vector);
+    idx_vector = _mm512_add_pd(idx_vector, eight_vector);
+  }
+
+  double pi = _mm512_reduce_add_pd(result_vector);
+  if(exact < end) pi += sum_avx512_fast_wide(exact, end, steps);
+
+  return pi + sum_scalar(end, to);
+}
+
+// The float32 kernels have twice the lanes of the double ones,
+// FLOAT32_BLOCK is a multiple of every vector width, so the signals
+// of each block are the same as the first one
+
+__attribute__((target("sse2")))
+static double sum_sse2_float32(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 3);
+  float first = (from & 1) ? -1.0f : 1.0f;
+
+  __m128 signal_vector = _mm_setr_ps(first, -first, first, -first);
+  __m128 two_vector = _mm_set1_ps(2.0f);
+  __m128 four_vector = _mm_set1_ps(4.0f);
+  __m128d total_vector = _mm_setzero_pd();
+
+  for(size_t block = from; block < end; block += FLOAT32_BLOCK) {
+    size_t block_end = end - block > FLOAT32_BLOCK ? block + FLOAT32_BLOCK : end;
+    __m128 start_vector = _mm_set1_ps((float) (2.0 * (double) block + 1.0));
+    __m128 offset_vector = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 result_vector = _mm_setzero_ps();
+
+    for(size_t i = block; i < block_end; i += 4) {
+      __m128 den_vector = _mm_add_ps(_mm_mul_ps(two_vector, offset_vector), start_vector);
+
+      result_vector = _mm_add_ps(result_vector, _mm_div_ps(signal_vector, den_vector));
+      offset_vector = _mm_add_ps(offset_vector, four_vector);
+    }
+
+    total_vector = _mm_add_pd(total_vector, _mm_cvtps_pd(result_vector));
+    total_vector = _mm_add_pd(total_vector, _mm_cvtps_pd(_mm_movehl_ps(result_vector, result_vector)));
+  }
+
+  double temp[2];
+  _mm_storeu_pd(temp, total_vector);
+
+  return (temp[0] + temp[1]) + sum_scalar_float32(end, to);
+}
+
+__attribute__((target("avx2,fma")))
+static double sum_avx2_float32(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 7);
+  float first = (from & 1) ? -1.0f : 1.0f;
+
+  __m256 signal_vector = _mm256_setr_ps(first, -first, first, -first,
+                                        first, -first, first, -first);
+  __m256 two_vector = _mm256_set1_ps(2.0f);
+  __m256 eight_vector = _mm256_set1_ps(8.0f);
+  __m256d total_vector = _mm256_setzero_pd();
+
+  for(size_t block = from; block < end; block += FLOAT32_BLOCK) {
+    size_t block_end = end - block > FLOAT32_BLOCK ? block + FLOAT32_BLOCK : end;
+    __m256 start_vector = _mm256_set1_ps((float) (2.0 * (double) block + 1.0));
+    __m256 offset_vector = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 result_vector = _mm256_setzero_ps();
+
+    for(size_t i = block; i < block_end; i += 8) {
+      __m256 den_vector = _mm256_fmadd_ps(two_vector, offset_vector, start_vector);
+
+      result_vector = _mm256_add_ps(result_vector, _mm256_div_ps(signal_vector, den_vector));
+      offset_vector = _mm256_add_ps(offset_vector, eight_vector);
+    }
+
+    total_vector = _mm256_add_pd(total_vector, _mm256_cvtps_pd(_mm256_castps256_ps128(result_vector)));
+    total_vector = _mm256_add_pd(total_vector, _mm256_cvtps_pd(_mm256_extractf128_ps(result_vector, 1)));
+  }
+
+  double temp[4];
+  _mm256_storeu_pd(temp, total_vector);
+
+  return ((temp[0] + temp[1]) + (temp[2] + temp[3])) + sum_scalar_float32(end, to);
+}
+
+__attribute__((target("avx512f")))
+static double sum_avx512_float32(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 15);
+  float first = (from & 1) ? -1.0f : 1.0f;
+
+  __m512 signal_vector = _mm512_setr_ps(first, -first, first, -first, first, -first, first, -first,
+                                        first, -first, first, -first, first, -first, first, -first);
+  __m512 two_vector = _mm512_set1_ps(2.0f);
+  __m512 sixteen_vector = _mm512_set1_ps(16.0f);
+  __m512d total_vector = _mm512_setzero_pd();
+
+  for(size_t block = from; block < end; block += FLOAT32_BLOCK) {
+    size_t block_end = end - block > FLOAT32_BLOCK ? block + FLOAT32_BLOCK : end;
+    __m512 start_vector = _mm512_set1_ps((float) (2.0 * (double) block + 1.0));
+    __m512 offset_vector = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                          8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    __m512 result_vector = _mm512_setzero_ps();
+
+    for(size_t i = block; i < block_end; i += 16) {
+      __m512 den_vector = _mm512_fmadd_ps(two_vector, offset_vector, start_vector);
+
+      result_vector = _mm512_add_ps(result_vector, _mm512_div_ps(signal_vector, den_vector));
+      offset_vector = _mm512_add_ps(offset_vector, sixteen_vector);
+    }
+
+    __m512 high_vector = _mm512_castpd_ps(_mm512_shuffle_f64x2(_mm512_castps_pd(result_vector),
+                                                               _mm512_castps_pd(result_vector), 0xEE));
+    total_vector = _mm512_add_pd(total_vector, _mm512_cvtps_pd(_mm512_castps512_ps256(result_vector)));
+    total_vector = _mm512_add_pd(total_vector, _mm512_cvtps_pd(_mm512_castps512_ps256(high_vector)));
+  }
+
+  return _mm512_reduce_add_pd(total_vector) + sum_scalar_float32(end, to);
+}
+
+// The double-double kernels do the same as sum_scalar_dd on every lane,
+// and then add the lanes as double-doubles. Past KERNEL_EXACT_INDEX the _wide
+// functions take den_lo out of the remainders, like sum_scalar_dd_wide
+
+__attribute__((target("avx2,fma"), noinline))
+static dd_t sum_avx2_dd_wide(size_t from, size_t end) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m256d signal_vector = _mm256_setr_pd(first, -first, first, -first);
+  __m256d step_vector = _mm256_set1_pd(8.0);
+  __m256d hi_vector = _mm256_setzero_pd();
+  __m256d lo_vector = _mm256_setzero_pd();
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m256d start_vector = _mm256_set1_pd(start.hi);
+    __m256d offset_vector = _mm256_add_pd(_mm256_set1_pd(start.lo), _mm256_setr_pd(0.0, 2.0, 4.0, 6.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 4) {
+      __m256d den_vector = _mm256_add_pd(start_vector, offset_vector);
+      __m256d den_lo_vector = _mm256_sub_pd(offset_vector, _mm256_sub_pd(den_vector, start_vector));
+      __m256d q_vector = _mm256_div_pd(signal_vector, den_vector);
+      __m256d r_vector = _mm256_fnmadd_pd(q_vector, den_lo_vector, _mm256_fnmadd_pd(q_vector, den_vector, signal_vector));
+      __m256d rcp_vector = _mm256_mul_pd(q_vector, signal_vector);
+
+      __m256d sum_vector = _mm256_add_pd(hi_vector, q_vector);
+      __m256d bb_vector = _mm256_sub_pd(sum_vector, hi_vector);
+      __m256d error_vector = _mm256_add_pd(_mm256_sub_pd(hi_vector, _mm256_sub_pd(sum_vector, bb_vector)),
+                                         _mm256_sub_pd(q_vector, bb_vector));
+
+      hi_vector = sum_vector;
+      lo_vector = _mm256_fmadd_pd(r_vector, rcp_vector, _mm256_add_pd(lo_vector, error_vector));
+      offset_vector = _mm256_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  double hi[4], lo[4];
+  _mm256_storeu_pd(hi, hi_vector);
+  _mm256_storeu_pd(lo, lo_vector);
+
+  dd_t pi = { 0.0, 0.0 };
+  for(int lane = 0; lane < 4; ++lane) {
+    pi = dd_add(pi, fast_two_sum(hi[lane], lo[lane]));
+  }
+
+  return pi;
+}
+
+__attribute__((target("avx2,fma")))
+static dd_t sum_avx2_dd(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 3);
+  size_t exact = exact_vectors_end(from, end, 4);
+  double first = (from & 1) ? -1.0 : 1.0;
+  double base = (double) from;
+
+  __m256d signal_vector = _mm256_setr_pd(first, -first, first, -first);
+  __m256d one_vector = _mm256_set1_pd(1.0);
+  __m256d two_vector = _mm256_set1_pd(2.0);
+  __m256d four_vector = _mm256_set1_pd(4.0);
+  __m256d hi_vector = _mm256_setzero_pd();
+  __m256d lo_vector = _mm256_setzero_pd();
+  __m256d idx_vector = _mm256_setr_pd(base, base + 1.0, base + 2.0, base + 3.0);
+
+  for(size_t i = from; i < exact; i += 4) {
+    __m256d den_vector = _mm256_fmadd_pd(two_vector, idx_vector, one_vector);
+    __m256d q_vector = _mm256_div_pd(signal_vector, den_vector);
+    __m256d r_vector = _mm256_fnmadd_pd(q_vector, den_vector, signal_vector);
+    __m256d term_lo_vector = _mm256_mul_pd(_mm256_mul_pd(r_vector, q_vector), signal_vector);
+
+    __m256d sum_vector = _mm256_add_pd(hi_vector, q_vector);
+    __m256d bb_vector = _mm256_sub_pd(sum_vector, hi_vector);
+    __m256d error_vector = _mm256_add_pd(_mm256_sub_pd(hi_vector, _mm256_sub_pd(sum_vector, bb_vector)),
+                                         _mm256_sub_pd(q_vector, bb_vector));
+
+    hi_vector = sum_vector;
+    lo_vector = _mm256_add_pd(lo_vector, _mm256_add_pd(error_vector, term_lo_vector));
+    idx_vector = _mm256_add_pd(idx_vector, four_vector);
+  }
+
+  double hi[4], lo[4];
+  _mm256_storeu_pd(hi, hi_vector);
+  _mm256_storeu_pd(lo, lo_vector);
+
+  dd_t pi = sum_scalar_dd(end, to);
+  for(int lane = 0; lane < 4; ++lane) {
+    pi = dd_add(pi, fast_two_sum(hi[lane], lo[lane]));
+  }
+
+  return exact < end ? dd_add(pi, sum_avx2_dd_wide(exact, end)) : pi;
+}
+
+__attribute__((target("avx512f"), noinline))
+static dd_t sum_avx512_dd_wide(size_t from, size_t end) {
+  double first = (from & 1) ? -1.0 : 1.0;
+
+  __m512d signal_vector = _mm512_setr_pd(first, -first, first, -first,
+                                         first, -first, first, -first);
+  __m512d step_vector = _mm512_set1_pd(16.0);
+  __m512d hi_vector = _mm512_setzero_pd();
+  __m512d lo_vector = _mm512_setzero_pd();
+
+  for(size_t chunk = from; chunk < end; chunk += KERNEL_WIDE_CHUNK) {
+    size_t chunk_end = wide_chunk_end(chunk, end);
+    dd_t start = wide_start(chunk);
+    __m512d start_vector = _mm512_set1_pd(start.hi);
+    __m512d offset_vector = _mm512_add_pd(_mm512_set1_pd(start.lo),
+                                          _mm512_setr_pd(0.0, 2.0, 4.0, 6.0, 8.0, 10.0, 12.0, 14.0));
+
+    for(size_t i = chunk; i < chunk_end; i += 8) {
+      __m512d den_vector = _mm512_add_pd(start_vector, offset_vector);
+      __m512d den_lo_vector = _mm512_sub_pd(offset_vector, _mm512_sub_pd(den_vector, start_vector));
+      __m512d q_vector = _mm512_div_pd(signal_vector, den_vector);
+      __m512d r_vector = _mm512_fnmadd_pd(q_vector, den_lo_vector, _mm512_fnmadd_pd(q_vector, den_vector, signal_vector));
+      __m512d rcp_vector = _mm512_mul_pd(q_vector, signal_vector);
+
+      __m512d sum_vector = _mm512_add_pd(hi_vector, q_vector);
+      __m512d bb_vector = _mm512_sub_pd(sum_vector, hi_vector);
+      __m512d error_vector = _mm512_add_pd(_mm512_sub_pd(hi_vector, _mm512_sub_pd(sum_vector, bb_vector)),
+                                         _mm512_sub_pd(q_vector, bb_vector));
+
+      hi_vector = sum_vector;
+      lo_vector = _mm512_fmadd_pd(r_vector, rcp_vector, _mm512_add_pd(lo_vector, error_vector));
+      offset_vector = _mm512_add_pd(offset_vector, step_vector);
+    }
+  }
+
+  double hi[8], lo[8];
+  _mm512_storeu_pd(hi, hi_vector);
+  _mm512_storeu_pd(lo, lo_vector);
+
+  dd_t pi = { 0.0, 0.0 };
+  for(int lane = 0; lane < 8; ++lane) {
+    pi = dd_add(pi, fast_two_sum(hi[lane], lo[lane]));
+  }
+
+  return pi;
+}
+
+__attribute__((target("avx512f")))
+static dd_t sum_avx512_dd(size_t from, size_t to) {
+  size_t end = from + ((to - from) & ~(size_t) 7);
+  size_t exact = exact_vectors_end(from, end, 8);
+  double first = (from & 1) ? -1.0 : 1.0;
+  double base = (double) from;
+
+  __m512d signal_vector = _mm512_setr_pd(first, -first, first, -first,
+                                         first, -first, first, -first);
+  __m512d one_vector = _mm512_set1_pd(1.0);
+  __m512d two_vector = _mm512_set1_pd(2.0);
+  __m512d eight_vector = _mm512_set1_pd(8.0);
+  __m512d hi_vector = _mm512_setzero_pd();
+  __m512d lo_vector = _mm512_setzero_pd();
+  __m512d idx_vector = _mm512_setr_pd(base, base + 1.0, base + 2.0, base + 3.0,
+                                      base + 4.0, base + 5.0, base + 6.0, base + 7.0);
+
+  for(size_t i = from; i < exact; i += 8) {
+    __m512d den_vector = _mm512_fmadd_pd(two_vector, idx_vector, one_vector);
+    __m512d q_vector = _mm512_div_pd(signal_vector, den_vector);
+    __m512d r_vector = _mm512_fnmadd_pd(q_vector, den_vector, signal_vector);
+    __m512d term_lo_vector = _mm512_mul_pd(_mm512_mul_pd(r_vector, q_vector), signal_vector);
+
+    __m512d sum_vector = _mm512_add_pd(hi_vector, q_vector);
+    __m512d bb_vector = _mm512_sub_pd(sum_vector, hi_vector);
+    __m512d error_vector = _mm512_add_pd(_mm512_sub_pd(hi_vector, _mm512_sub_pd(sum_vector, bb_vector)),
+                                         _mm512_sub_pd(q_vector, bb_vector));
+
+    hi_vector = sum_vector;
+    lo_vector = _mm512_add_pd(lo_vector, _mm512_add_pd(error_vector, term_lo_vector));
+    idx_vector = _mm512_add_pd(idx_vector, eight_vector);
+  }
+
+  double hi[8], lo[8];
+  _mm512_storeu_pd(hi, hi_vector);
+  _mm512_storeu_pd(lo, lo_vector);
+
+  dd_t pi = sum_scalar_dd(end, to);
+  for(int lane = 0; lane < 8; ++lane) {
+    pi = dd_add(pi, fast_two_sum(hi[lane], lo[lane]));
+  }
+
+  return exact < end ? dd_add(pi, sum_avx512_dd_wide(exact, end)) : pi;
+}
+#endif
+
+static const kernel_t kernels[] = {
+  { "scalar", sum_scalar, NULL, sum_scalar_float32, sum_scalar_dd, sum_series_scalar },
+#ifdef KERNEL_X86
+  // Without FMA the remainder isn't exact, so SSE2 uses the scalar double-double kernel
+  { "sse2", sum_sse2, NULL, sum_sse2_float32, sum_scalar_dd, sum_series_sse2 },
+  { "avx2", sum_avx2, sum_avx2_fast, sum_avx2_float32, sum_avx2_dd, sum_series_avx2 },
+  { "avx512", sum_avx512, sum_avx512_fast, sum_avx512_float32, sum_avx512_dd, sum_series_avx512 },
+#endif
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+dd_t kernel_sum(const kernel_t *kernel, const kernel_mode_t *mode, size_t from, size_t to) {
+  dd_t sum = { 0.0, 0.0 };
+
+  switch(mode->type) {
+    case TYPE_FLOAT32:
+      sum.hi = kernel->sum_float32(from, to);
+      break;
+    case TYPE_DOUBLE_DOUBLE:
+      sum = kernel->sum_dd(from, to);
+      break;
+    default:
+      if(mode->precision == PRECISION_FAST && kernel->sum_fast) {
+        sum.hi = kernel->sum_fast(from, to, mode->steps);
+      } else {
+        sum.hi = kernel->sum(from, to);
+      }
+  }
+
+  return sum;
+}
+
+dd_t kernel_sum_series(const kernel_t *kernel, const series_t *series, size_t from, size_t to) {
+  dd_t sum = { kernel->sum_series(series, from, to), 0.0 };
+
+  return sum;
+}
+
+dd_t kernel_add(const kernel_mode_t *mode, dd_t a, dd_t b) {
+  if(mode->type == TYPE_DOUBLE_DOUBLE) return dd_add(a, b);
+
+  a.hi += b.hi;
+
+  return a;
+}
+
+static int kernel_supported(size_t index) {
+#ifdef KERNEL_X86
+  // __builtin_cpu_supports also checks if the OS saves the wider registers
+  __builtin_cpu_init();
+
+  switch(index) {
+    case 1: return __builtin_cpu_supports("sse2");
+    case 2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case 3: return __builtin_cpu_supports("avx512f");
+  }
+#endif
+
+  return index == 0;
+}
+
+size_t kernel_available(const kernel_t **list, size_t capacity) {
+  size_t count = 0;
+
+  for(size_t i = 0; i < KERNEL_COUNT && count < capacity; ++i) {
+    if(kernel_supported(i)) list[count++] = &kernels[i];
+  }
+
+  return count;
+}
+
+const kernel_t *kernel_select(void) {
+  const kernel_t *list[KERNEL_COUNT];
+  size_t count = kernel_available(list, KERNEL_COUNT);
+
+  return list[count - 1];
+}
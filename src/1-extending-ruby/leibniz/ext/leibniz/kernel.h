@@ -0,0 +1,94 @@
+#ifndef LEIBNIZ_KERNEL_H
+#define LEIBNIZ_KERNEL_H
+
+#include <stddef.h>
+
+// Double-double number, its value is hi + lo
+typedef struct {
+  double hi;
+  double lo;
+} dd_t;
+
+// The denominators 2i + 1 are computed as 64 bit integers, so i must be below 2^63
+#define KERNEL_MAX_TERMS ((size_t) 1 << 63)
+
+// Sums the terms (-1)^i / (2i + 1) for every i in [from, to)
+typedef double (*kernel_fn)(size_t from, size_t to);
+// Same, but the divisions are replaced by a hardware reciprocal estimate,
+// refined by the given number of Newton-Raphson steps
+typedef double (*kernel_fast_fn)(size_t from, size_t to, int steps);
+// Same, but the sum is kept as a double-double
+typedef dd_t (*kernel_dd_fn)(size_t from, size_t to);
+
+// The other series the kernels can sum, see kernel_series.c
+typedef enum {
+  // (-1)^i / ((2i + 2)(2i + 3)(2i + 4)), pi = 3 + 4 * sum
+  SERIES_NILAKANTHA,
+  // r^i / (2i + 1), arctan(1 / x) = sum / x with r = -1 / x^2
+  SERIES_GEOMETRIC
+} series_kind;
+
+typedef struct {
+  series_kind kind;
+  // r of SERIES_GEOMETRIC, -1 <= r < 0
+  double ratio;
+} series_t;
+
+// Sums the terms of the series for every i in [from, to)
+typedef double (*kernel_series_fn)(const series_t *series, size_t from, size_t to);
+
+typedef struct {
+  const char *name;
+  kernel_fn sum;
+  // NULL when there's no fast version, the divisions are used instead
+  kernel_fast_fn sum_fast;
+  // Computes the terms as floats, returning the sum as a double
+  kernel_fn sum_float32;
+  kernel_dd_fn sum_dd;
+  kernel_series_fn sum_series;
+} kernel_t;
+
+typedef enum {
+  PRECISION_EXACT,
+  PRECISION_FAST
+} precision_t;
+
+typedef enum {
+  TYPE_DOUBLE,
+  TYPE_FLOAT32,
+  TYPE_DOUBLE_DOUBLE
+} type_t;
+
+#define KERNEL_DEFAULT_STEPS 2
+#define KERNEL_MAX_STEPS 3
+
+// How the terms are computed, the precision only applies to TYPE_DOUBLE
+typedef struct {
+  type_t type;
+  precision_t precision;
+  int steps;
+} kernel_mode_t;
+
+// Sums the terms in [from, to) with the given kernel and mode,
+// lo is only used by TYPE_DOUBLE_DOUBLE
+dd_t kernel_sum(const kernel_t *kernel, const kernel_mode_t *mode, size_t from, size_t to);
+// Sums the terms of another series in [from, to), always as doubles
+dd_t kernel_sum_series(const kernel_t *kernel, const series_t *series, size_t from, size_t to);
+// Adds two sums the same way the mode does: double-double arithmetic
+// for TYPE_DOUBLE_DOUBLE, and a plain addition of hi otherwise
+dd_t kernel_add(const kernel_mode_t *mode, dd_t a, dd_t b);
+
+double sum_series_scalar(const series_t *series, size_t from, size_t to);
+#if defined(__x86_64__) || defined(__i386__)
+double sum_series_sse2(const series_t *series, size_t from, size_t to);
+double sum_series_avx2(const series_t *series, size_t from, size_t to);
+double sum_series_avx512(const series_t *series, size_t from, size_t to);
+#endif
+
+// Picks the widest kernel supported by the running CPU
+const kernel_t *kernel_select(void);
+// Fills the list with the kernels supported by the running CPU,
+// from the narrowest to the widest, returning how many there are
+size_t kernel_available(const kernel_t **list, size_t capacity);
+
+#endif
@@ -0,0 +1,91 @@
+#include <math.h>
+#include "kernel.h"
+
+// Kernels of the series other than Leibniz. There's one loop for each series,
+// written with the GCC vector extensions so the same code is compiled for every
+// target, instead of being written again with the intrinsics of each one.
+// As in kernel.c, each lane handles the index (from + lane) and the number of
+// lanes is even, so the signals never change
+
+static double nilakantha_scalar(size_t from, size_t to) {
+  double sum = 0.0;
+  double signal = (from & 1) ? 1.0 : -1.0;
+
+  for(size_t i = from; i < to; ++i) {
+    double a = 2.0 * (double) i + 2.0;
+
+    signal = -signal;
+    sum += signal / (a * (a + 1.0) * (a + 2.0));
+  }
+
+  return sum;
+}
+
+// The powers underflow to 0 after a few hundred terms, unless r is -1,
+// so the loop stops as soon as the power is 0
+static double geometric_scalar(double ratio, size_t from, size_t to) {
+  double sum = 0.0;
+  double power = pow(ratio, (double) from);
+
+  for(size_t i = from; i < to && power != 0.0; ++i) {
+    sum += power / (2.0 * (double) i + 1.0);
+    power *= ratio;
+  }
+
+  return sum;
+}
+
+double sum_series_scalar(const series_t *series, size_t from, size_t to) {
+  if(series->kind == SERIES_NILAKANTHA) return nilakantha_scalar(from, to);
+
+  return geometric_scalar(series->ratio, from, to);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Defines sum_series_<name> for vectors of `lanes` doubles.
+// The powers of the geometric series start at r^(from + lane) and
+// are multiplied by r^lanes every iteration, the first lane has the
+// largest one, so it's the one checked for the underflow
+#define SERIES_KERNEL(name, isa, lanes)                                             \
+  __attribute__((target(isa)))                                                      \
+  double sum_series_##name(const series_t *series, size_t from, size_t to) {        \
+    typedef double vector __attribute__((vector_size(8 * (lanes))));                \
+    size_t end = from + ((to - from) & ~(size_t) ((lanes) - 1));                    \
+    vector idx, signal, power, result = { 0.0 };                                    \
+                                                                                    \
+    for(int lane = 0; lane < (lanes); ++lane) {                                     \
+      idx[lane] = (double) (from + lane);                                           \
+      signal[lane] = ((from + lane) & 1) ? -1.0 : 1.0;                              \
+      power[lane] = pow(series->ratio, (double) (from + lane));                     \
+    }                                                                               \
+                                                                                    \
+    size_t i = from;                                                                \
+    if(series->kind == SERIES_NILAKANTHA) {                                         \
+      for(; i < end; i += (lanes)) {                                                \
+        vector a = 2.0 * idx + 2.0;                                                 \
+        result += signal / (a * (a + 1.0) * (a + 2.0));                             \
+        idx += (double) (lanes);                                                    \
+      }                                                                             \
+    } else {                                                                        \
+      double stride = pow(series->ratio, (double) (lanes));                         \
+      for(; i < end && power[0] != 0.0; i += (lanes)) {                             \
+        result += power / (2.0 * idx + 1.0);                                        \
+        power *= stride;                                                            \
+        idx += (double) (lanes);                                                    \
+      }                                                                             \
+    }                                                                               \
+                                                                                    \
+    double sum = 0.0;                                                               \
+    for(int lane = 0; lane < (lanes); ++lane) {                                     \
+      sum += result[lane];                                                          \
+    }                                                                               \
+                                                                                    \
+    return sum + sum_series_scalar(series, end, to);                                \
+  }
+
+SERIES_KERNEL(sse2, "sse2", 2)
+SERIES_KERNEL(avx2, "avx2,fma", 4)
+SERIES_KERNEL(avx512, "avx512f", 8)
+
+#endif
@@ -1,20 +1,580 @@
-#include <ruby.h>
+#include "leibniz.h"
+#include "cache.h"
+#include "probes.h"
+#include "stats.h"
+#include <ruby/thread.h>
+#include <float.h>
+#include <math.h>
 #include <stdio.h>
 
-VALUE calc(VALUE self, VALUE times) {
-  size_t n = RB_NUM2SIZE(times);
-  double pi = 0.0;
-  double signal = -1.0;
+// Selected once in Init_leibniz, based on the CPU running the extension
+static const kernel_t *kernel;
 
-  for(size_t i = 0; i < n; ++i) {
-    signal = -signal;
-    pi += signal / (2 * i + 1);
+static VALUE timeoutErrorClass;
+static ID options_ids[5];
+static ID estimate_ids[2];
+static ID id_exact, id_fast, id_double, id_float32, id_double_double;
+
+void parse_options(VALUE opts, calc_options *options) {
+  VALUE values[5];
+
+  options->threads = 1;
+  options->timeout = 0.0;
+  options->mode.type = TYPE_DOUBLE;
+  options->mode.precision = PRECISION_EXACT;
+  options->mode.steps = KERNEL_DEFAULT_STEPS;
+  if(NIL_P(opts)) return;
+
+  rb_get_kwargs(opts, options_ids, 0, 5, values);
+
+  if(values[0] != Qundef) {
+    int threads = NUM2INT(values[0]);
+    if(threads < 1 || threads > JOB_MAX_THREADS) {
+      rb_raise(rb_eArgError, "threads must be between 1 and %d", JOB_MAX_THREADS);
+    }
+    options->threads = (unsigned) threads;
+  }
+
+  if(values[1] != Qundef && !NIL_P(values[1])) {
+    options->timeout = NUM2DBL(values[1]);
+    if(!(options->timeout > 0.0)) {
+      rb_raise(rb_eArgError, "timeout must be positive");
+    }
+  }
+
+  if(values[2] != Qundef) {
+    ID precision = rb_sym2id(values[2]);
+    if(precision == id_exact) {
+      options->mode.precision = PRECISION_EXACT;
+    } else if(precision == id_fast) {
+      options->mode.precision = PRECISION_FAST;
+    } else {
+      rb_raise(rb_eArgError, "precision must be :exact or :fast");
+    }
+  }
+
+  if(values[3] != Qundef) {
+    int steps = NUM2INT(values[3]);
+    if(steps < 0 || steps > KERNEL_MAX_STEPS) {
+      rb_raise(rb_eArgError, "steps must be between 0 and %d", KERNEL_MAX_STEPS);
+    }
+    options->mode.steps = steps;
+  }
+
+  if(values[4] != Qundef) {
+    ID type = rb_sym2id(values[4]);
+    if(type == id_double) {
+      options->mode.type = TYPE_DOUBLE;
+    } else if(type == id_float32) {
+      options->mode.type = TYPE_FLOAT32;
+    } else if(type == id_double_double) {
+      options->mode.type = TYPE_DOUBLE_DOUBLE;
+    } else {
+      rb_raise(rb_eArgError, "type must be :double, :float32 or :double_double");
+    }
+  }
+}
+
+typedef struct {
+  job_t *job;
+  // stats_now() when the job stopped running
+  uint64_t finished;
+} gvl_run_t;
+
+// The terms and the kernel time are counted here, because a pending interrupt
+// raises as soon as rb_thread_call_without_gvl takes the GVL back
+static void *run_job_without_gvl(void *data) {
+  gvl_run_t *run = data;
+  size_t done = run->job->done;
+  uint64_t start = stats_now();
+
+  job_run(run->job);
+  run->finished = stats_now();
+  stats_add(STATS_KERNEL_NS, run->finished - start);
+  stats_add(STATS_TERMS, run->job->done - done);
+
+  return NULL;
+}
+
+// Unblocking function, called by Ruby when the thread is interrupted
+// (Ctrl-C, Thread#kill, Timeout.timeout, ...) while the GVL is released
+static void stop_job(void *job) {
+  job_stop(job);
+}
+
+void raise_timeout(size_t done, size_t total, double partial, size_t terms) {
+  VALUE error = rb_exc_new_str(
+    timeoutErrorClass,
+    rb_sprintf("computed %"PRIuSIZE" of %"PRIuSIZE" terms before the timeout", done, total)
+  );
+  rb_iv_set(error, "@partial", rb_float_new(partial));
+  rb_iv_set(error, "@terms", RB_SIZE2NUM(terms));
+
+  rb_exc_raise(error);
+}
+
+size_t num2terms(VALUE value) {
+  size_t n = RB_NUM2SIZE(value);
+  if(n > KERNEL_MAX_TERMS) rb_raise(rb_eRangeError, "at most 2**63 terms are supported");
+
+  return n;
+}
+
+void init_job(job_t *job, size_t from, size_t to, const calc_options *options) {
+  job_init(job, kernel, from, to, options->threads);
+  job->mode = options->mode;
+  if(options->timeout > 0.0) job->deadline = job_clock() + options->timeout;
+}
+
+void prepare_job(job_t *job, size_t from, size_t to, const calc_options *options) {
+  stats_add(STATS_CALLS, 1);
+  stats_add(STATS_THREADS, options->threads);
+
+  init_job(job, from, to, options);
+}
+
+// Small jobs are computed right away, releasing the GVL
+// would cost more than the job itself.
+// Interrupts are checked between blocks: pending exceptions are raised
+// when rb_thread_call_without_gvl returns, otherwise the job goes on
+void run_job(job_t *job) {
+  size_t done = job->done;
+  uint64_t start = stats_now();
+
+  LEIBNIZ_PROBE3(job__entry, job->from + done, job->to, job->threads);
+
+  if(job->to - job->from - job->done <= JOB_BLOCK) {
+    job_run(job);
+    stats_add(STATS_KERNEL_NS, stats_now() - start);
+    stats_add(STATS_TERMS, job->done - done);
+    LEIBNIZ_PROBE2(job__return, job->done - done, atomic_load(&job->status));
+    return;
   }
 
+  gvl_run_t run = { job, 0 };
+
+  for(;;) {
+    rb_thread_call_without_gvl(run_job_without_gvl, &run, stop_job, job);
+
+    // An interrupt can skip the job, then it didn't run at all
+    if(run.finished) stats_add(STATS_GVL_WAIT_NS, stats_now() - run.finished);
+    run.finished = 0;
+
+    if(atomic_load(&job->status) != JOB_STOPPED) break;
+
+    rb_thread_check_ints();
+    job_resume(job);
+  }
+
+  LEIBNIZ_PROBE2(job__return, job->done - done, atomic_load(&job->status));
+}
+
+typedef struct {
+  job_t *job;
+  cache_t *cache;
+} cached_job_t;
+
+// Stores the sum of the job at each checkpoint it goes through, the cached jobs start at 0.
+// cache_store ignores the ones that are already stored or past the capacity
+static void store_checkpoint(const job_t *job, void *cache) {
+  if(job->done % CACHE_STRIDE == 0) cache_store(cache, job->done, job->sum);
+}
+
+// Starts the job from the last checkpoint before its end, and runs it
+// in a single pass with every thread, storing the checkpoints on the way
+static VALUE run_cached_job(VALUE data) {
+  cached_job_t *cached = (cached_job_t *) data;
+  job_t *job = cached->job;
+
+  job->done = cache_lookup(cached->cache, job->to, &job->sum);
+  job->checkpoint = store_checkpoint;
+  job->checkpoint_data = cached->cache;
+  run_job(job);
+
+  return Qnil;
+}
+
+static VALUE release_cache(VALUE cache) {
+  cache_release((cache_t *) cache);
+
+  return Qnil;
+}
+
+static double sum(size_t from, size_t to, const calc_options *options) {
+  job_t job;
+
+  prepare_job(&job, from, to, options);
+
+  cache_t *cache = from == 0 && to >= CACHE_STRIDE ? cache_acquire(&options->mode) : NULL;
+  if(cache) {
+    cached_job_t cached = { &job, cache };
+    rb_ensure(run_cached_job, (VALUE) &cached, release_cache, (VALUE) cache);
+  } else {
+    run_job(&job);
+  }
+
+  if(atomic_load(&job.status) == JOB_EXPIRED) {
+    raise_timeout(job.done, to - from, job_sum(&job) * 4.0, job.done);
+  }
+
+  return job_sum(&job);
+}
+
+// Leibniz.calc(n, threads: 1, timeout: nil, precision: :exact, steps: 2, type: :double)
+VALUE calc(int argc, VALUE *argv, VALUE self) {
+  VALUE times, opts;
+  calc_options options;
+
+  rb_scan_args(argc, argv, "1:", &times, &opts);
+  size_t n = num2terms(times);
+  parse_options(opts, &options);
+
+  LEIBNIZ_PROBE2(calc__entry, n, options.threads);
+  double pi = sum(0, n, &options);
+  LEIBNIZ_PROBE1(calc__return, n);
+
+  return rb_float_new(pi * 4.0);
+}
+
+// Leibniz.partial_sum(from, to, **options), takes the same options as calc
+// Contribution of the terms in [from, to) to the estimate, so
+// partial_sum(0, a) + partial_sum(a, n) is calc(n) up to rounding.
+// Each half is rounded on its own, so they differ in the last bits
+// for any a, even a multiple of JOB_BLOCK
+VALUE partial_sum(int argc, VALUE *argv, VALUE self) {
+  VALUE first, last, opts;
+  calc_options options;
+
+  rb_scan_args(argc, argv, "2:", &first, &last, &opts);
+  size_t from = num2terms(first);
+  size_t to = num2terms(last);
+  parse_options(opts, &options);
+
+  if(from > to) rb_raise(rb_eArgError, "from must not be greater than to");
+
+  double pi = sum(from, to, &options);
+
   return rb_float_new(pi * 4.0);
 }
 
+typedef struct {
+  size_t n;
+  long index;
+} checkpoint_t;
+
+static int compare_checkpoints(const void *a, const void *b) {
+  size_t x = ((const checkpoint_t *) a)->n;
+  size_t y = ((const checkpoint_t *) b)->n;
+
+  return (x > y) - (x < y);
+}
+
+// Leibniz.calc_many([n1, n2, ...], **options), takes the same options as calc
+// Computes the estimates for every n in a single pass up to the largest one.
+// The job only goes up to the last full block before each n, and the rest
+// is added just like calc does, so each estimate is the same as calc(n)
+VALUE calc_many(int argc, VALUE *argv, VALUE self) {
+  VALUE counts, opts, buffer;
+  calc_options options;
+  job_t job;
+
+  rb_scan_args(argc, argv, "1:", &counts, &opts);
+  counts = rb_Array(counts);
+  parse_options(opts, &options);
+
+  long length = RARRAY_LEN(counts);
+  checkpoint_t *checkpoints = ALLOCV_N(checkpoint_t, buffer, length);
+  for(long i = 0; i < length; ++i) {
+    checkpoints[i].n = num2terms(RARRAY_AREF(counts, i));
+    checkpoints[i].index = i;
+  }
+  qsort(checkpoints, length, sizeof(checkpoint_t), compare_checkpoints);
+
+  VALUE estimates = rb_ary_new_capa(length);
+  prepare_job(&job, 0, 0, &options);
+
+  for(long i = 0; i < length; ++i) {
+    size_t n = checkpoints[i].n;
+
+    job_extend(&job, n - n % JOB_BLOCK);
+    run_job(&job);
+    // The pass goes up to the largest n, which is the last one
+    if(atomic_load(&job.status) == JOB_EXPIRED) {
+      raise_timeout(job.done, checkpoints[length - 1].n, job_sum(&job) * 4.0, job.done);
+    }
+
+    uint64_t start = stats_now();
+    dd_t pi = kernel_add(&job.mode, job.sum, kernel_sum(kernel, &job.mode, job.to, n));
+    stats_add(STATS_KERNEL_NS, stats_now() - start);
+    stats_add(STATS_TERMS, n - job.to);
+    rb_ary_store(estimates, checkpoints[i].index, rb_float_new((pi.hi + pi.lo) * 4.0));
+  }
+
+  ALLOCV_END(buffer);
+
+  return estimates;
+}
+
+// Reads step: and limit: out of the keyword arguments of each_estimate,
+// leaving the options shared with calc. A nil limit means no limit
+static void parse_estimate_options(VALUE opts, size_t *step, size_t *limit) {
+  VALUE values[2];
+
+  rb_get_kwargs(opts, estimate_ids, 1, -2, values);
+
+  *step = RB_NUM2SIZE(values[0]);
+  if(*step == 0) rb_raise(rb_eArgError, "step must be positive");
+
+  *limit = values[1] == Qundef || NIL_P(values[1]) ? SIZE_MAX : num2terms(values[1]);
+}
+
+static VALUE each_estimate_size(VALUE self, VALUE args, VALUE eobj) {
+  size_t step, limit;
+  // Without arguments, args isn't an Array
+  VALUE opts = RB_TYPE_P(args, T_ARRAY) ? rb_check_hash_type(rb_ary_entry(args, -1)) : Qnil;
+
+  if(NIL_P(opts)) return Qnil;
+  parse_estimate_options(rb_hash_dup(opts), &step, &limit);
+  if(limit == SIZE_MAX) return DBL2NUM(HUGE_VAL);
+
+  return RB_SIZE2NUM(limit / step + (limit % step != 0));
+}
+
+// Leibniz.each_estimate(step:, limit: nil, **options) { |terms, pi| ... }
+// takes the same options as calc, and returns an Enumerator without a block.
+// Yields the estimate after every step terms, and after limit terms.
+// The job goes up to the last full block, as in calc_many, and the terms after it
+// are added as they come, so the whole enumeration computes O(limit) terms.
+// The estimates are the same as calc when step is a multiple of 2^20,
+// otherwise they can differ from it in the last bits
+VALUE each_estimate(int argc, VALUE *argv, VALUE self) {
+  VALUE opts;
+  calc_options options;
+  job_t job;
+  size_t step, limit;
+
+  RETURN_SIZED_ENUMERATOR(self, argc, argv, each_estimate_size);
+
+  rb_scan_args(argc, argv, ":", &opts);
+  if(NIL_P(opts)) rb_raise(rb_eArgError, "missing keyword: :step");
+  parse_estimate_options(opts, &step, &limit);
+  parse_options(opts, &options);
+
+  prepare_job(&job, 0, 0, &options);
+  dd_t tail = { 0.0, 0.0 };
+  size_t tail_to = 0;
+
+  for(size_t n = 0; n < limit;) {
+    n = limit - n > step ? n + step : limit;
+
+    if(n - job.to >= JOB_BLOCK) {
+      job_extend(&job, n - n % JOB_BLOCK);
+      run_job(&job);
+      // n is the next multiple of step, or limit
+      if(atomic_load(&job.status) == JOB_EXPIRED) {
+        raise_timeout(job.done, n, job_sum(&job) * 4.0, job.done);
+      }
+
+      tail.hi = tail.lo = 0.0;
+      tail_to = job.to;
+    }
+
+    uint64_t start = stats_now();
+    tail = kernel_add(&job.mode, tail, kernel_sum(kernel, &job.mode, tail_to, n));
+    stats_add(STATS_KERNEL_NS, stats_now() - start);
+    stats_add(STATS_TERMS, n - tail_to);
+    tail_to = n;
+
+    dd_t pi = kernel_add(&job.mode, job.sum, tail);
+    rb_yield_values(2, RB_SIZE2NUM(n), rb_float_new((pi.hi + pi.lo) * 4.0));
+  }
+
+  return self;
+}
+
+// Euler numbers E_0, E_2, E_4, ... used by the tail correction
+static const double euler_numbers[] = {
+  1.0, -1.0, 5.0, -61.0, 1385.0, -50521.0, 2702765.0, -199360981.0,
+  19391512145.0, -2404879675441.0, 370371188237525.0, -69348874393137901.0,
+};
+#define EULER_NUMBERS (sizeof(euler_numbers) / sizeof(euler_numbers[0]))
+#define PRECISION_MAX_TERMS ((size_t) 1 << 20)
+
+// Leibniz.calc_to_precision(digits) => [pi, terms]
+// The error of the first m terms has a known asymptotic expansion:
+//   pi - 4 * S(m) ~ (-1)^m * 2 * sum(E_2k / (2m)^(2k + 1))
+// so adding it to the partial sum corrects most of the slow convergence.
+// The number of terms doubles until the first omitted correction,
+// plus the rounding errors of the sum, fits in the requested digits
+VALUE calc_to_precision(VALUE self, VALUE digits) {
+  int d = NUM2INT(digits);
+  if(d < 1 || d > DBL_DIG) rb_raise(rb_eArgError, "digits must be between 1 and %d", DBL_DIG);
+
+  double tolerance = 0.5 * pow(10.0, 1 - d);
+  double partial = 0.0;
+  size_t m = 0;
+
+  for(size_t next = 2; next <= PRECISION_MAX_TERMS; next *= 2) {
+    partial += kernel->sum(m, next);
+    m = next;
+
+    double n = 2.0 * (double) m;
+    double power = n;
+    double correction = 0.0;
+    double previous = 0.0;
+    double omitted = 0.0;
+
+    // It's an asymptotic series, so the terms stop decreasing at some point.
+    // When the table runs out, the last term is taken as the error
+    for(size_t k = 0; k < EULER_NUMBERS; ++k) {
+      double term = 2.0 * euler_numbers[k] / power;
+      omitted = term;
+      if(k > 0 && fabs(term) >= fabs(previous)) break;
+
+      correction += term;
+      previous = term;
+      power *= n * n;
+    }
+
+    double error = fabs(omitted) + (double) (m + 4) * DBL_EPSILON;
+    if(error <= tolerance) {
+      double pi = partial * 4.0 + ((m & 1) ? -correction : correction);
+
+      return rb_ary_new_from_args(2, rb_float_new(pi), RB_SIZE2NUM(m));
+    }
+  }
+
+  rb_raise(rb_eRangeError, "could not reach %d digits", d);
+}
+
+// The installed cache is shared by the whole process, so like a global variable
+// only the main Ractor can change it. Every Ractor uses it
+static void check_main_ractor(void) {
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+  VALUE ractor = rb_path2class("Ractor");
+
+  if(rb_funcall(ractor, rb_intern("current"), 0) != rb_funcall(ractor, rb_intern("main"), 0)) {
+    rb_raise(rb_path2class("Ractor::UnsafeError"), "the cache can only be opened or closed by the main Ractor");
+  }
+#endif
+}
+
+// Leibniz.open_cache(path, precision: :exact, steps: 2, type: :double)
+// Maps the checkpoint file at path, creating it if needed, and uses it for
+// calc and partial_sum from 0 with the same precision, steps and type.
+// The file can be shared by several processes at once
+VALUE open_cache(int argc, VALUE *argv, VALUE self) {
+  VALUE path, opts;
+  calc_options options;
+  cache_t *cache;
+
+  rb_scan_args(argc, argv, "1:", &path, &opts);
+  FilePathValue(path);
+  parse_options(opts, &options);
+  check_main_ractor();
+
+  int error = cache_open(&cache, RSTRING_PTR(path), kernel, &options.mode);
+  if(error == CACHE_MISMATCH) {
+    rb_raise(rb_eArgError, "%"PRIsVALUE" is a cache for another kernel, mode or version", path);
+  }
+  if(error) rb_syserr_fail_str(error, path);
+
+  cache_install(cache);
+
+  return Qnil;
+}
+
+// Stops using the cache, the calls already using it finish with it
+VALUE close_cache(VALUE self) {
+  check_main_ractor();
+  cache_install(NULL);
+
+  return Qnil;
+}
+
+// Returns the name of the kernel in use, e.g. :avx2
+VALUE kernel_name(VALUE self) {
+  return ID2SYM(rb_intern(kernel->name));
+}
+
+// Leibniz.stats => {kernel: :avx2, calls: 3, terms: 3000000, ...}
+// Counters of every call in the process since it started or since reset_stats,
+// the times are in nanoseconds. The mean threads per call is threads / calls
+VALUE stats(VALUE self) {
+  uint64_t totals[STATS_COUNTERS];
+  stats_read(totals);
+
+  VALUE hash = rb_hash_new();
+  rb_hash_aset(hash, ID2SYM(rb_intern("kernel")), kernel_name(self));
+#ifdef LEIBNIZ_NO_STATS
+  rb_hash_aset(hash, ID2SYM(rb_intern("enabled")), Qfalse);
+#else
+  rb_hash_aset(hash, ID2SYM(rb_intern("enabled")), Qtrue);
+#endif
+  rb_hash_aset(hash, ID2SYM(rb_intern("calls")), ULL2NUM(totals[STATS_CALLS]));
+  rb_hash_aset(hash, ID2SYM(rb_intern("terms")), ULL2NUM(totals[STATS_TERMS]));
+  rb_hash_aset(hash, ID2SYM(rb_intern("threads")), ULL2NUM(totals[STATS_THREADS]));
+  rb_hash_aset(hash, ID2SYM(rb_intern("kernel_ns")), ULL2NUM(totals[STATS_KERNEL_NS]));
+  rb_hash_aset(hash, ID2SYM(rb_intern("gvl_wait_ns")), ULL2NUM(totals[STATS_GVL_WAIT_NS]));
+
+  return hash;
+}
+
+VALUE reset_stats(VALUE self) {
+  stats_reset();
+
+  return Qnil;
+}
+
+// The other globals are only written here, the installed cache is behind a mutex
+// and only changed by the main Ractor, and the stats counters are thread safe,
+// so the methods can be called from any Ractor
 void Init_leibniz(void) {
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+  rb_ext_ractor_safe(true);
+#endif
+
+  kernel = kernel_select();
+  options_ids[0] = rb_intern("threads");
+  options_ids[1] = rb_intern("timeout");
+  options_ids[2] = rb_intern("precision");
+  options_ids[3] = rb_intern("steps");
+  options_ids[4] = rb_intern("type");
+  estimate_ids[0] = rb_intern("step");
+  estimate_ids[1] = rb_intern("limit");
+  id_exact = rb_intern("exact");
+  id_fast = rb_intern("fast");
+  id_double = rb_intern("double");
+  id_float32 = rb_intern("float32");
+  id_double_double = rb_intern("double_double");
+
   VALUE leibnizModule = rb_define_module("Leibniz");
-  rb_define_singleton_method(leibnizModule, "calc", calc, 1);
+  rb_define_singleton_method(leibnizModule, "calc", calc, -1);
+  rb_define_singleton_method(leibnizModule, "partial_sum", partial_sum, -1);
+  rb_define_singleton_method(leibnizModule, "calc_many", calc_many, -1);
+  rb_define_singleton_method(leibnizModule, "each_estimate", each_estimate, -1);
+  rb_define_singleton_method(leibnizModule, "calc_to_precision", calc_to_precision, 1);
+  rb_define_singleton_method(leibnizModule, "kernel", kernel_name, 0);
+  rb_define_singleton_method(leibnizModule, "open_cache", open_cache, -1);
+  rb_define_singleton_method(leibnizModule, "close_cache", close_cache, 0);
+  rb_define_singleton_method(leibnizModule, "stats", stats, 0);
+  rb_define_singleton_method(leibnizModule, "reset_stats", reset_stats, 0);
+
+  // Raised when a timeout: is given and the computation doesn't finish in time,
+  // it carries the estimate of the terms computed so far
+  timeoutErrorClass = rb_define_class_under(leibnizModule, "TimeoutError", rb_eStandardError);
+  rb_define_attr(timeoutErrorClass, "partial", 1, 0);
+  rb_define_attr(timeoutErrorClass, "terms", 1, 0);
+
+  // Creating a Leibniz::Accumulator Class
+  init_accumulator(leibnizModule);
+
+  // Creating a Leibniz::Future Class, returned by Leibniz.calc_async
+  init_future(leibnizModule);
+
+  // Creating a Leibniz::Series Class, for the other series of pi and arctan
+  init_series(leibnizModule);
+
+  // Defining Leibniz.digits, the exact decimals of pi
+  init_digits(leibnizModule);
 }
@@ -0,0 +1,34 @@
+#ifndef LEIBNIZ_H
+#define LEIBNIZ_H
+
+#include <ruby.h>
+#include "job.h"
+
+typedef struct {
+  unsigned threads;
+  // Seconds, or 0 when there's no timeout
+  double timeout;
+  kernel_mode_t mode;
+} calc_options;
+
+// Reads the keyword arguments shared by the calc methods
+void parse_options(VALUE opts, calc_options *options);
+// Converts a number of terms, or an index, raising RangeError above KERNEL_MAX_TERMS
+size_t num2terms(VALUE value);
+// Sets up a job for the terms in [from, to) using the selected kernel
+void init_job(job_t *job, size_t from, size_t to, const calc_options *options);
+// Same, counting it as a call in Leibniz.stats
+void prepare_job(job_t *job, size_t from, size_t to, const calc_options *options);
+// Runs the job until it's done or expired. Exceptions raised by interrupts
+// are propagated, the job keeps the blocks computed until then
+void run_job(job_t *job);
+// Raises Leibniz::TimeoutError for an expired job that computed done of the total
+// terms it was asked for, partial and terms are the estimate and terms it reached
+NORETURN(void raise_timeout(size_t done, size_t total, double partial, size_t terms));
+
+VALUE init_accumulator(VALUE super);
+VALUE init_future(VALUE super);
+VALUE init_series(VALUE super);
+void init_digits(VALUE super);
+
+#endif
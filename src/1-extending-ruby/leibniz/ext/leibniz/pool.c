@@ -0,0 +1,200 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+#include "stats.h"
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+// Tasks are computed in the order they're submitted,
+// each worker runs one job at a time with the job's own threads
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t available = PTHREAD_COND_INITIALIZER;
+static pool_task_t *head;
+static pool_task_t *tail;
+static unsigned workers;
+// Task run by each worker, so the ones cut short by a fork can be found
+static pool_task_t *running[POOL_MAX_WORKERS];
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+static void notify(pool_task_t *task) {
+#ifdef HAVE_SYS_EVENTFD_H
+  uint64_t one = 1;
+#else
+  char one = 1;
+#endif
+
+  // It's only written once, so the pipe can't be full
+  while(write(task->notify_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+// Sets fds to the read and write ends of a new notification fd
+static int open_fds(int fds[2]) {
+#ifdef HAVE_SYS_EVENTFD_H
+  fds[0] = fds[1] = eventfd(0, EFD_CLOEXEC);
+  return fds[0] < 0 ? -1 : 0;
+#else
+  if(pipe(fds) < 0) return -1;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return 0;
+#endif
+}
+
+pool_task_t *pool_task_new(void) {
+  int fds[2];
+  pool_task_t *task = calloc(1, sizeof(pool_task_t));
+  if(!task) return NULL;
+
+  if(open_fds(fds) < 0) {
+    free(task);
+    return NULL;
+  }
+  task->fd = fds[0];
+  task->notify_fd = fds[1];
+  atomic_init(&task->state, POOL_QUEUED);
+  atomic_init(&task->refs, 1);
+
+  return task;
+}
+
+void pool_task_release(pool_task_t *task) {
+  if(atomic_fetch_sub(&task->refs, 1) != 1) return;
+
+  close(task->fd);
+  if(task->notify_fd != task->fd) close(task->notify_fd);
+  free(task);
+}
+
+static void *work(void *data) {
+  unsigned index = (unsigned) (uintptr_t) data;
+
+  for(;;) {
+    pthread_mutex_lock(&lock);
+    while(!head) pthread_cond_wait(&available, &lock);
+
+    pool_task_t *task = head;
+    head = task->next;
+    if(!head) tail = NULL;
+    running[index] = task;
+    atomic_store(&task->state, POOL_RUNNING);
+    pthread_mutex_unlock(&lock);
+
+    // A task whose future was collected is stopped, so it returns right away
+    size_t done = task->job.done;
+    uint64_t start = stats_now();
+    job_run(&task->job);
+    stats_add(STATS_KERNEL_NS, stats_now() - start);
+    stats_add(STATS_TERMS, task->job.done - done);
+
+    // Notified with the lock held, so a fork can't happen in between
+    pthread_mutex_lock(&lock);
+    running[index] = NULL;
+    atomic_store(&task->state, POOL_FINISHED);
+    notify(task);
+    pthread_mutex_unlock(&lock);
+
+    pool_task_release(task);
+  }
+
+  return NULL;
+}
+
+static void before_fork(void) {
+  pthread_mutex_lock(&lock);
+}
+
+static void after_fork_parent(void) {
+  pthread_mutex_unlock(&lock);
+}
+
+// The fds are shared with the parent, so the child gets new ones
+// in their place before waking up its waiters
+static void lose(pool_task_t *task) {
+  int fds[2];
+
+  if(open_fds(fds) == 0) {
+    dup2(fds[0], task->fd);
+    dup2(fds[1], task->notify_fd);
+    close(fds[0]);
+    if(fds[1] != fds[0]) close(fds[1]);
+  }
+
+  atomic_store(&task->state, POOL_LOST);
+  notify(task);
+  pool_task_release(task);
+}
+
+// Only the forking thread exists in the child, so the pending tasks
+// are marked as lost, and the next submit starts new workers
+static void after_fork_child(void) {
+  for(unsigned i = 0; i < workers; ++i) {
+    if(!running[i]) continue;
+
+    lose(running[i]);
+    running[i] = NULL;
+  }
+
+  while(head) {
+    pool_task_t *task = head;
+    head = task->next;
+    lose(task);
+  }
+
+  tail = NULL;
+  workers = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+static void register_fork_handlers(void) {
+  pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+}
+
+// Called with the lock held
+static int start_workers(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned count = cpus < 1 ? 1 : cpus > POOL_MAX_WORKERS ? POOL_MAX_WORKERS : (unsigned) cpus;
+  pthread_attr_t attr;
+  int error = 0;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  while(workers < count) {
+    pthread_t thread;
+    error = pthread_create(&thread, &attr, work, (void *) (uintptr_t) workers);
+    if(error) break;
+    ++workers;
+  }
+
+  pthread_attr_destroy(&attr);
+
+  return workers ? 0 : error;
+}
+
+int pool_submit(pool_task_t *task) {
+  pthread_once(&fork_once, register_fork_handlers);
+  pthread_mutex_lock(&lock);
+
+  int error = workers ? 0 : start_workers();
+  if(!error) {
+    atomic_fetch_add(&task->refs, 1);
+    task->next = NULL;
+    if(tail) {
+      tail->next = task;
+    } else {
+      head = task;
+    }
+    tail = task;
+    pthread_cond_signal(&available);
+  }
+
+  pthread_mutex_unlock(&lock);
+
+  return error;
+}
@@ -0,0 +1,39 @@
+#ifndef LEIBNIZ_POOL_H
+#define LEIBNIZ_POOL_H
+
+#include "job.h"
+
+#define POOL_MAX_WORKERS 64
+
+typedef enum {
+  POOL_QUEUED,
+  POOL_RUNNING,
+  POOL_FINISHED,
+  // The process forked while the task was pending, the child has no worker for it
+  POOL_LOST
+} pool_state;
+
+// A job computed by the pool. When it's finished, fd becomes readable,
+// so a thread or a fiber scheduler can wait on it like on any IO
+typedef struct pool_task {
+  job_t job;
+  int fd;
+  // Same as fd for an eventfd, the write end of the pipe otherwise
+  int notify_fd;
+  atomic_int state;
+  // The submitter and the pool each hold a reference while they use the task
+  atomic_int refs;
+  // Next task in the queue
+  struct pool_task *next;
+} pool_task_t;
+
+// Returns a task with a single reference, or NULL with errno set.
+// The job has to be set up before submitting it
+pool_task_t *pool_task_new(void);
+// Queues the task, starting the workers on the first call.
+// Returns 0, or an errno value when no worker could be started
+int pool_submit(pool_task_t *task);
+// Drops a reference, the last one frees the task
+void pool_task_release(pool_task_t *task);
+
+#endif
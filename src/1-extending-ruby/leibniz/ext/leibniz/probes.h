@@ -0,0 +1,26 @@
+#ifndef LEIBNIZ_PROBES_H
+#define LEIBNIZ_PROBES_H
+
+// USDT probes, for perf, bpftrace or systemtap, e.g. the latency of Leibniz.calc:
+//   bpftrace -e 'usdt:./leibniz.so:leibniz:calc__entry { @start[tid] = nsecs; }
+//                usdt:./leibniz.so:leibniz:calc__return /@start[tid]/ { @ns = hist(nsecs - @start[tid]); }'
+// A probe is a single nop until a tracer attaches to it, which then reads the arguments
+// from where the compiler left them. They need sys/sdt.h (systemtap-sdt-dev),
+// otherwise or with `ruby extconf.rb --disable-probes` they're compiled out.
+//
+//   calc__entry(n, threads)       Leibniz.calc is called
+//   calc__return(n)               and returns, exceptions skip the return probes
+//   job__entry(from, to, threads) a job starts or resumes on the terms in [from, to)
+//   job__return(terms, status)    it stops after computing terms, with a job_status
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define LEIBNIZ_PROBE1(name, a) DTRACE_PROBE1(leibniz, name, a)
+#define LEIBNIZ_PROBE2(name, a, b) DTRACE_PROBE2(leibniz, name, a, b)
+#define LEIBNIZ_PROBE3(name, a, b, c) DTRACE_PROBE3(leibniz, name, a, b, c)
+#else
+#define LEIBNIZ_PROBE1(name, a) ((void) 0)
+#define LEIBNIZ_PROBE2(name, a, b) ((void) 0)
+#define LEIBNIZ_PROBE3(name, a, b, c) ((void) 0)
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+#include <math.h>
+#include "leibniz.h"
+
+#define SERIES_MAX_COMPONENTS 2
+
+// One of the series summed by a Leibniz::Series, with its coefficient
+typedef struct {
+  double coefficient;
+  // NULL for the Leibniz series, so it uses the same kernels as Leibniz.calc
+  const series_t *series;
+  series_t data;
+} component_t;
+
+// The value is offset + the sum of coefficient * sum of the first n terms of each component
+typedef struct {
+  ID name;
+  double x;
+  double offset;
+  int count;
+  component_t components[SERIES_MAX_COMPONENTS];
+} series_data_t;
+
+static const rb_data_type_t series_type = {
+  .wrap_struct_name = "Leibniz::Series",
+  .function = {
+    .dfree = RUBY_TYPED_DEFAULT_FREE,
+  },
+  // It's frozen by initialize and has no references, so it can be shared between Ractors
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_FROZEN_SHAREABLE,
+};
+
+static ID id_leibniz, id_nilakantha, id_madhava, id_arctan, id_machin;
+
+static VALUE series_alloc(VALUE klass) {
+  series_data_t *data;
+
+  return TypedData_Make_Struct(klass, series_data_t, &series_type, data);
+}
+
+static series_data_t *get_series(VALUE self) {
+  series_data_t *data;
+  TypedData_Get_Struct(self, series_data_t, &series_type, data);
+  if(data->count == 0) rb_raise(rb_eTypeError, "uninitialized series");
+
+  return data;
+}
+
+static void add_component(series_data_t *data, double coefficient, series_kind kind, double ratio) {
+  component_t *component = &data->components[data->count++];
+
+  component->coefficient = coefficient;
+  component->data.kind = kind;
+  component->data.ratio = ratio;
+  component->series = &component->data;
+}
+
+// arctan(1 / x) = sum((-1 / x^2)^i / (2i + 1)) / x
+static void add_arctan(series_data_t *data, double coefficient, double x) {
+  add_component(data, coefficient / x, SERIES_GEOMETRIC, -1.0 / (x * x));
+}
+
+// Leibniz::Series.new(:leibniz | :nilakantha | :madhava | :machin)
+// Leibniz::Series.new(:arctan, x), the series of arctan(1 / x) for x >= 1.
+// The other series compute pi, Machin's formula is 16 arctan(1/5) - 4 arctan(1/239)
+static VALUE series_initialize(int argc, VALUE *argv, VALUE self) {
+  VALUE kind, x;
+  series_data_t *data;
+
+  TypedData_Get_Struct(self, series_data_t, &series_type, data);
+  rb_scan_args(argc, argv, "11", &kind, &x);
+  if(data->count) rb_raise(rb_eRuntimeError, "series already initialized");
+
+  ID name = rb_sym2id(kind);
+  if(name != id_arctan && !NIL_P(x)) rb_raise(rb_eArgError, "only the arctan series takes x");
+
+  if(name == id_leibniz) {
+    data->components[data->count++].coefficient = 4.0;
+  } else if(name == id_nilakantha) {
+    add_component(data, 4.0, SERIES_NILAKANTHA, 0.0);
+    data->offset = 3.0;
+  } else if(name == id_madhava) {
+    add_component(data, sqrt(12.0), SERIES_GEOMETRIC, -1.0 / 3.0);
+  } else if(name == id_arctan) {
+    if(NIL_P(x)) rb_raise(rb_eArgError, "the arctan series needs x");
+    data->x = NUM2DBL(x);
+    if(!(data->x >= 1.0) || isinf(data->x)) rb_raise(rb_eArgError, "x must be at least 1");
+    add_arctan(data, 1.0, data->x);
+  } else if(name == id_machin) {
+    add_arctan(data, 16.0, 5.0);
+    add_arctan(data, -4.0, 239.0);
+  } else {
+    rb_raise(rb_eArgError, "series must be :leibniz, :nilakantha, :madhava, :arctan or :machin");
+  }
+
+  data->name = name;
+  rb_obj_freeze(self);
+
+  return self;
+}
+
+// First index where r^i of a geometric series is below half the smallest
+// subnormal, so it and every term after it round to 0. The kernels stop there
+// too, but only after starting every block up to the end, one pow per block.
+// It never underflows for r = -1, the arctan of 1
+static size_t underflow_index(const series_t *series) {
+  if(series->kind != SERIES_GEOMETRIC || fabs(series->ratio) >= 1.0) return KERNEL_MAX_TERMS;
+
+  double index = ceil(1075.0 / -log2(fabs(series->ratio)));
+
+  return index < (double) KERNEL_MAX_TERMS ? (size_t) index : KERNEL_MAX_TERMS;
+}
+
+// Sums [from, to) of each component, with the same jobs as Leibniz.calc,
+// so they're split in blocks, computed by the threads and can be interrupted.
+// The terms of the geometric series after they underflow aren't computed.
+// Only the Leibniz series uses the type: and precision: options
+static double series_sum(const series_data_t *data, size_t from, size_t to, const calc_options *options) {
+  double total = 0.0;
+  job_t job;
+
+  for(int c = 0; c < data->count; ++c) {
+    const component_t *component = &data->components[c];
+    size_t end = component->series ? underflow_index(component->series) : to;
+    if(end > to) end = to;
+
+    // Each component is a job, but the sum is a single call
+    if(c == 0) {
+      prepare_job(&job, from < end ? from : end, end, options);
+    } else {
+      init_job(&job, from < end ? from : end, end, options);
+    }
+    if(component->series) {
+      if(options->mode.type != TYPE_DOUBLE || options->mode.precision != PRECISION_EXACT) {
+        rb_raise(rb_eArgError, "the %s series only supports type: :double and precision: :exact", rb_id2name(data->name));
+      }
+      job.series = component->series;
+    }
+    run_job(&job);
+
+    total += component->coefficient * job_sum(&job);
+    if(atomic_load(&job.status) == JOB_EXPIRED) {
+      raise_timeout(job.done, to - from, total, job.done);
+    }
+  }
+
+  return total;
+}
+
+// Leibniz::Series#calc(n, **options), takes the same options as Leibniz.calc
+// The value of the first n terms: pi, or arctan(1 / x) for the arctan series
+static VALUE series_calc(int argc, VALUE *argv, VALUE self) {
+  VALUE times, opts;
+  calc_options options;
+  series_data_t *data = get_series(self);
+
+  rb_scan_args(argc, argv, "1:", &times, &opts);
+  size_t n = num2terms(times);
+  parse_options(opts, &options);
+
+  return rb_float_new(data->offset + series_sum(data, 0, n, &options));
+}
+
+// Leibniz::Series#partial_sum(from, to, **options)
+// Contribution of the terms in [from, to), so
+// partial_sum(0, a) + partial_sum(a, n) is the same as calc(n), but for the offset
+// of the series (3 for Nilakantha), which is only added by calc
+static VALUE series_partial_sum(int argc, VALUE *argv, VALUE self) {
+  VALUE first, last, opts;
+  calc_options options;
+  series_data_t *data = get_series(self);
+
+  rb_scan_args(argc, argv, "2:", &first, &last, &opts);
+  size_t from = num2terms(first);
+  size_t to = num2terms(last);
+  parse_options(opts, &options);
+
+  if(from > to) rb_raise(rb_eArgError, "from must not be greater than to");
+
+  return rb_float_new(series_sum(data, from, to, &options));
+}
+
+static VALUE series_initialize_copy(VALUE self, VALUE other) {
+  series_data_t *data;
+
+  TypedData_Get_Struct(self, series_data_t, &series_type, data);
+  rb_check_frozen(self);
+  *data = *get_series(other);
+
+  // The components point to their own data
+  for(int c = 0; c < data->count; ++c) {
+    if(data->components[c].series) data->components[c].series = &data->components[c].data;
+  }
+
+  return self;
+}
+
+static VALUE series_name(VALUE self) {
+  return ID2SYM(get_series(self)->name);
+}
+
+// x of the arctan series, nil for the others
+static VALUE series_x(VALUE self) {
+  series_data_t *data = get_series(self);
+
+  return data->name == id_arctan ? rb_float_new(data->x) : Qnil;
+}
+
+VALUE init_series(VALUE super) {
+  id_leibniz = rb_intern("leibniz");
+  id_nilakantha = rb_intern("nilakantha");
+  id_madhava = rb_intern("madhava");
+  id_arctan = rb_intern("arctan");
+  id_machin = rb_intern("machin");
+
+  VALUE seriesClass = rb_define_class_under(super, "Series", rb_cObject);
+  rb_define_alloc_func(seriesClass, series_alloc);
+  rb_define_method(seriesClass, "initialize", series_initialize, -1);
+  rb_define_method(seriesClass, "initialize_copy", series_initialize_copy, 1);
+  rb_define_method(seriesClass, "calc", series_calc, -1);
+  rb_define_method(seriesClass, "partial_sum", series_partial_sum, -1);
+  rb_define_method(seriesClass, "name", series_name, 0);
+  rb_define_method(seriesClass, "x", series_x, 0);
+
+  return seriesClass;
+}
@@ -0,0 +1,114 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "stats.h"
+
+#ifdef LEIBNIZ_NO_STATS
+
+void stats_read(uint64_t totals[STATS_COUNTERS]) {
+  memset(totals, 0, sizeof(uint64_t) * STATS_COUNTERS);
+}
+
+void stats_reset(void) {
+}
+
+#else
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Only the owner thread writes to a block, the readers may see
+// a slightly old value but never a torn one.
+// Blocks are never freed: when a thread exits, its block goes to a free list
+// and is reused by the next thread, keeping the counts it had
+typedef struct stats_block {
+  atomic_uint_fast64_t counters[STATS_COUNTERS];
+  struct stats_block *next;
+  struct stats_block *next_free;
+} stats_block_t;
+
+static _Atomic(stats_block_t *) blocks;
+static stats_block_t *free_blocks;
+// Totals at the last reset, subtracted when reading
+static uint64_t baseline[STATS_COUNTERS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static _Thread_local stats_block_t *local;
+
+static void release_block(void *block) {
+  pthread_mutex_lock(&lock);
+  ((stats_block_t *) block)->next_free = free_blocks;
+  free_blocks = block;
+  pthread_mutex_unlock(&lock);
+}
+
+static void create_key(void) {
+  pthread_key_create(&key, release_block);
+}
+
+static stats_block_t *acquire_block(void) {
+  stats_block_t *block;
+
+  pthread_once(&key_once, create_key);
+  pthread_mutex_lock(&lock);
+
+  if(free_blocks) {
+    block = free_blocks;
+    free_blocks = block->next_free;
+  } else if((block = calloc(1, sizeof(stats_block_t)))) {
+    block->next = atomic_load_explicit(&blocks, memory_order_relaxed);
+    atomic_store_explicit(&blocks, block, memory_order_release);
+  }
+
+  pthread_mutex_unlock(&lock);
+  if(block) pthread_setspecific(key, block);
+
+  return block;
+}
+
+uint64_t stats_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+void stats_add(stats_counter counter, uint64_t value) {
+  if(!local && !(local = acquire_block())) return;
+
+  atomic_uint_fast64_t *slot = &local->counters[counter];
+  atomic_store_explicit(slot, atomic_load_explicit(slot, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static void sum_blocks(uint64_t totals[STATS_COUNTERS]) {
+  memset(totals, 0, sizeof(uint64_t) * STATS_COUNTERS);
+
+  stats_block_t *block = atomic_load_explicit(&blocks, memory_order_acquire);
+  for(; block; block = block->next) {
+    for(int i = 0; i < STATS_COUNTERS; ++i) {
+      totals[i] += atomic_load_explicit(&block->counters[i], memory_order_relaxed);
+    }
+  }
+}
+
+void stats_read(uint64_t totals[STATS_COUNTERS]) {
+  sum_blocks(totals);
+
+  pthread_mutex_lock(&lock);
+  for(int i = 0; i < STATS_COUNTERS; ++i) totals[i] -= baseline[i];
+  pthread_mutex_unlock(&lock);
+}
+
+// The other threads may be updating their blocks, so instead of
+// clearing them, the current totals become the new zero
+void stats_reset(void) {
+  uint64_t totals[STATS_COUNTERS];
+  sum_blocks(totals);
+
+  pthread_mutex_lock(&lock);
+  memcpy(baseline, totals, sizeof(totals));
+  pthread_mutex_unlock(&lock);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef LEIBNIZ_STATS_H
+#define LEIBNIZ_STATS_H
+
+#include <stdint.h>
+
+// Counters of the work done by the extension, shown by Leibniz.stats.
+// Each thread adds to its own block of counters, so an update is a plain
+// load and store without locks, and reading them adds up every block
+typedef enum {
+  STATS_CALLS,
+  STATS_TERMS,
+  // Sum of the threads used by each call
+  STATS_THREADS,
+  // Time spent running jobs, with or without the GVL
+  STATS_KERNEL_NS,
+  // Time between the end of a job and getting the GVL back
+  STATS_GVL_WAIT_NS,
+  STATS_COUNTERS
+} stats_counter;
+
+#ifdef LEIBNIZ_NO_STATS
+
+// Built with --disable-stats, the counters are compiled out
+static inline uint64_t stats_now(void) { return 0; }
+static inline void stats_add(stats_counter counter, uint64_t value) { (void) counter; (void) value; }
+
+#else
+
+// Monotonic clock in nanoseconds
+uint64_t stats_now(void);
+void stats_add(stats_counter counter, uint64_t value);
+
+#endif
+
+// Fills totals with the counters since the last reset
+void stats_read(uint64_t totals[STATS_COUNTERS]);
+void stats_reset(void);
+
+#endif
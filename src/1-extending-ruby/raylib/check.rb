@@ -0,0 +1,39 @@
+#!/usr/bin/env ruby
+
+# Checks of the native classes that don't need a window, run by `make check`
+
+require_relative 'window.so'
+
+def check(description)
+  abort "check failed: #{description}" unless yield
+end
+
+def raises?(error)
+  yield
+  false
+rescue error
+  true
+end
+
+# The palette and Color[] are frozen and shared between Ractors, nothing can change them
+[Raylib::RED, Raylib::Color[1, 2, 3]].each do |color|
+  original = color.inspect
+
+  check("#{original} is frozen") { color.frozen? && Ractor.shareable?(color) }
+  check("#{original}.red= raises") { raises?(FrozenError) { color.red = 0 } }
+  check("#{original}.initialize raises") { raises?(FrozenError) { color.send(:initialize, 0, 0, 0, 0) } }
+  check("#{original}.initialize_copy raises") { raises?(FrozenError) { color.send(:initialize_copy, Raylib::BLACK) } }
+  check("#{original} is unchanged") { color.inspect == original }
+end
+check('Color[] is interned') { Raylib::Color[230, 41, 55].equal? Raylib::RED }
+check('Color.new is mutable') { Raylib::Color.new(0, 0, 0, 0).tap { |c| c.red = 255 }.red == 255 }
+
+# A frozen command buffer keeps its commands
+buffer = Raylib::CommandBuffer.new
+buffer.clear_background Raylib::RAYWHITE
+buffer.freeze
+check('a frozen CommandBuffer#initialize raises') { raises?(FrozenError) { buffer.send(:initialize) } }
+check('a frozen CommandBuffer#clear raises') { raises?(FrozenError) { buffer.clear } }
+check('a frozen CommandBuffer is unchanged') { buffer.size == 1 }
+
+puts 'all checks passed'
@@ -1,43 +1,238 @@
 #include "color.h"
+#include <ruby/ractor.h>
 
-// Same as:
-// class Color
-//   def initialize(red, green, blue, alpha)
-//     @red = red
-//     @green = green
-//     @blue = blue
-//     @alpha = alpha
-//   end
-// end
+// Raylib::Color wraps the raylib Color struct itself, 4 bytes of RGBA,
+// so passing it to raylib is a single load instead of an instance variable
+// lookup and a conversion per component
+_Static_assert(sizeof(Color) == sizeof(uint32_t), "Color must be packed in 4 bytes");
+
+static const rb_data_type_t color_type = {
+  .wrap_struct_name = "Raylib::Color",
+  .function = {
+    .dfree = RUBY_TYPED_DEFAULT_FREE,
+  },
+  // There are no Ruby objects inside, so it never needs write barriers,
+  // and a frozen color can be shared between Ractors
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | RUBY_TYPED_FROZEN_SHAREABLE,
+};
+
+static VALUE colorClass;
+
+static VALUE color_alloc(VALUE klass) {
+  Color *color;
+
+  return TypedData_Make_Struct(klass, Color, &color_type, color);
+}
+
+static Color *get_color_struct(VALUE self) {
+  Color *color;
+  TypedData_Get_Struct(self, Color, &color_type, color);
+
+  return color;
+}
+
+static unsigned char component(VALUE value) {
+  unsigned int component = NUM2UINT(value);
+  if(component > 255) rb_raise(rb_eRangeError, "color components must be between 0 and 255");
+
+  return (unsigned char) component;
+}
+
+// The components as a single integer, 0xRRGGBBAA
+static uint32_t packed(const Color *color) {
+  return (uint32_t) color->r << 24 | color->g << 16 | color->b << 8 | color->a;
+}
+
+// Raylib::Color.new(red, green, blue, alpha), each component between 0 and 255
 VALUE color_initialize(VALUE self, VALUE red, VALUE green, VALUE blue, VALUE alpha) {
-  rb_iv_set(self, "@red", red);
-  rb_iv_set(self, "@green", green);
-  rb_iv_set(self, "@blue", blue);
-  rb_iv_set(self, "@alpha", alpha);
+  // The palette and Color[] are frozen and shared, so they can't be initialized again
+  rb_check_frozen(self);
+  Color *color = get_color_struct(self);
+  color->r = component(red);
+  color->g = component(green);
+  color->b = component(blue);
+  color->a = component(alpha);
 
   return self;
 }
 
-// Helper function to build a Raylib Color struct from ruby Color class
+static VALUE color_initialize_copy(VALUE self, VALUE other) {
+  rb_check_frozen(self);
+  *get_color_struct(self) = *get_color_struct(other);
+
+  return self;
+}
+
+// Helper function to get the Raylib Color struct of a Raylib::Color
 Color get_color(VALUE colorObj) {
-  Color color;
-  color.r = (unsigned char) NUM2UINT(rb_iv_get(colorObj, "@red"));
-  color.g = (unsigned char) NUM2UINT(rb_iv_get(colorObj, "@green"));
-  color.b = (unsigned char) NUM2UINT(rb_iv_get(colorObj, "@blue"));
-  color.a = (unsigned char) NUM2UINT(rb_iv_get(colorObj, "@alpha"));
+  return *get_color_struct(colorObj);
+}
 
-  return color;
+// Interned colors, from the packed components to the frozen Raylib::Color.
+// They're never removed, the table is marked by internedHolder
+static st_table *internedColors;
+static VALUE internedHolder;
+
+static void interned_mark(void *table) {
+  rb_mark_tbl((st_table *) table);
+}
+
+static const rb_data_type_t interned_type = {
+  .wrap_struct_name = "Raylib::Color interned table",
+  .function = {
+    .dmark = interned_mark,
+  },
+};
+
+static VALUE intern(Color color) {
+  st_data_t interned;
+  if(st_lookup(internedColors, packed(&color), &interned)) return (VALUE) interned;
+
+  Color *data;
+  VALUE obj = TypedData_Make_Struct(colorClass, Color, &color_type, data);
+  *data = color;
+  rb_ractor_make_shareable(obj);
+  st_insert(internedColors, packed(&color), (st_data_t) obj);
+
+  return obj;
+}
+
+// Raylib::Color[red, green, blue, alpha = 255]
+// Returns the same frozen color for the same components,
+// so a render loop can use it without allocating new colors
+static VALUE color_intern(int argc, VALUE *argv, VALUE klass) {
+  VALUE red, green, blue, alpha;
+  rb_scan_args(argc, argv, "31", &red, &green, &blue, &alpha);
+
+  Color color = {
+    component(red),
+    component(green),
+    component(blue),
+    NIL_P(alpha) ? 255 : component(alpha),
+  };
+
+  return intern(color);
+}
+
+// The standard raylib colors, defined as constants of the Raylib module
+static void init_palette(VALUE super) {
+  const struct {
+    const char *name;
+    Color color;
+  } palette[] = {
+    { "LIGHTGRAY", LIGHTGRAY }, { "GRAY", GRAY }, { "DARKGRAY", DARKGRAY },
+    { "YELLOW", YELLOW }, { "GOLD", GOLD }, { "ORANGE", ORANGE },
+    { "PINK", PINK }, { "RED", RED }, { "MAROON", MAROON },
+    { "GREEN", GREEN }, { "LIME", LIME }, { "DARKGREEN", DARKGREEN },
+    { "SKYBLUE", SKYBLUE }, { "BLUE", BLUE }, { "DARKBLUE", DARKBLUE },
+    { "PURPLE", PURPLE }, { "VIOLET", VIOLET }, { "DARKPURPLE", DARKPURPLE },
+    { "BEIGE", BEIGE }, { "BROWN", BROWN }, { "DARKBROWN", DARKBROWN },
+    { "WHITE", WHITE }, { "BLACK", BLACK }, { "BLANK", BLANK },
+    { "MAGENTA", MAGENTA }, { "RAYWHITE", RAYWHITE },
+  };
+
+  for(size_t i = 0; i < sizeof(palette) / sizeof(palette[0]); ++i) {
+    rb_define_const(super, palette[i].name, intern(palette[i].color));
+  }
+}
+
+// Same as attr_accessor :red, :green, :blue, :alpha
+static VALUE color_red(VALUE self) {
+  return UINT2NUM(get_color_struct(self)->r);
+}
+
+static VALUE color_set_red(VALUE self, VALUE value) {
+  rb_check_frozen(self);
+  get_color_struct(self)->r = component(value);
+
+  return value;
+}
+
+static VALUE color_green(VALUE self) {
+  return UINT2NUM(get_color_struct(self)->g);
+}
+
+static VALUE color_set_green(VALUE self, VALUE value) {
+  rb_check_frozen(self);
+  get_color_struct(self)->g = component(value);
+
+  return value;
+}
+
+static VALUE color_blue(VALUE self) {
+  return UINT2NUM(get_color_struct(self)->b);
+}
+
+static VALUE color_set_blue(VALUE self, VALUE value) {
+  rb_check_frozen(self);
+  get_color_struct(self)->b = component(value);
+
+  return value;
+}
+
+static VALUE color_alpha(VALUE self) {
+  return UINT2NUM(get_color_struct(self)->a);
+}
+
+static VALUE color_set_alpha(VALUE self, VALUE value) {
+  rb_check_frozen(self);
+  get_color_struct(self)->a = component(value);
+
+  return value;
+}
+
+// Colors are equal when they have the same components, like a Struct
+static VALUE color_equal(VALUE self, VALUE other) {
+  if(!rb_typeddata_is_kind_of(other, &color_type)) return Qfalse;
+
+  return packed(get_color_struct(self)) == packed(get_color_struct(other)) ? Qtrue : Qfalse;
+}
+
+static VALUE color_hash(VALUE self) {
+  st_index_t hash = rb_hash_start(0);
+  hash = rb_hash_uint32(hash, packed(get_color_struct(self)));
+
+  return ST2FIX(rb_hash_end(hash));
+}
+
+static VALUE color_inspect(VALUE self) {
+  const Color *color = get_color_struct(self);
+
+  return rb_sprintf("#<%"PRIsVALUE" red=%u, green=%u, blue=%u, alpha=%u>",
+                    rb_class_name(rb_obj_class(self)), color->r, color->g, color->b, color->a);
 }
 
 VALUE init_color(VALUE super) {
-    VALUE colorClass = rb_define_class_under(super, "Color", rb_cObject);
+    colorClass = rb_define_class_under(super, "Color", rb_cObject);
+    // The interned table is shared, so Color[] is only called from the main Ractor
+    rb_define_singleton_method(colorClass, "[]", color_intern, -1);
+
+    // The other methods only touch their own color,
+    // so the shareable palette can be used from any Ractor
+    rb_ext_ractor_safe(true);
+    rb_define_alloc_func(colorClass, color_alloc);
     rb_define_method(colorClass, "initialize", color_initialize, 4);
+    rb_define_method(colorClass, "initialize_copy", color_initialize_copy, 1);
+
+    rb_define_method(colorClass, "red", color_red, 0);
+    rb_define_method(colorClass, "red=", color_set_red, 1);
+    rb_define_method(colorClass, "green", color_green, 0);
+    rb_define_method(colorClass, "green=", color_set_green, 1);
+    rb_define_method(colorClass, "blue", color_blue, 0);
+    rb_define_method(colorClass, "blue=", color_set_blue, 1);
+    rb_define_method(colorClass, "alpha", color_alpha, 0);
+    rb_define_method(colorClass, "alpha=", color_set_alpha, 1);
+
+    rb_define_method(colorClass, "==", color_equal, 1);
+    rb_define_method(colorClass, "eql?", color_equal, 1);
+    rb_define_method(colorClass, "hash", color_hash, 0);
+    rb_define_method(colorClass, "inspect", color_inspect, 0);
+    rb_ext_ractor_safe(false);
 
-    // Creating attr_acessor :red, :green, :blue, :alpha for our Color class
-    rb_define_attr(colorClass, "red", 1, 1);
-    rb_define_attr(colorClass, "green", 1, 1);
-    rb_define_attr(colorClass, "blue", 1, 1);
-    rb_define_attr(colorClass, "alpha", 1, 1);
+    internedColors = st_init_numtable();
+    internedHolder = TypedData_Wrap_Struct(0, &interned_type, internedColors);
+    rb_gc_register_address(&internedHolder);
+    init_palette(super);
 
     return colorClass;
 }
@@ -0,0 +1,270 @@
+#include <string.h>
+#include "command_buffer.h"
+#include "probes.h"
+#include "window.h"
+
+// Raylib::CommandBuffer records draw calls as compact binary commands,
+// and Raylib.submit replays them in C, so a frame with thousands of
+// primitives crosses into C once instead of once per primitive.
+//
+// The commands are stored one after the other in a growable arena,
+// each one starts with its header and is padded to COMMAND_ALIGN bytes.
+// #clear only resets the length, so a buffer reused every frame
+// stops allocating once it's large enough
+#define COMMAND_ALIGN 4
+#define COMMAND_BUFFER_CAPACITY 4096
+
+typedef enum {
+  COMMAND_CLEAR_BACKGROUND,
+  COMMAND_DRAW_TEXT
+} command_op;
+
+typedef struct {
+  uint32_t op;
+  // Bytes of the whole command, padding included
+  uint32_t size;
+} command_header;
+
+typedef struct {
+  command_header header;
+  Color color;
+} clear_background_command;
+
+typedef struct {
+  command_header header;
+  Color color;
+  int32_t x;
+  int32_t y;
+  int32_t font_size;
+  // NUL terminated
+  char text[];
+} draw_text_command;
+
+typedef struct {
+  unsigned char *data;
+  size_t length;
+  size_t capacity;
+  size_t commands;
+} command_buffer_t;
+
+static void command_buffer_free(void *ptr) {
+  command_buffer_t *buffer = ptr;
+
+  ruby_xfree(buffer->data);
+  ruby_xfree(buffer);
+}
+
+static size_t command_buffer_memsize(const void *ptr) {
+  const command_buffer_t *buffer = ptr;
+
+  return sizeof(*buffer) + buffer->capacity;
+}
+
+static const rb_data_type_t command_buffer_type = {
+  .wrap_struct_name = "Raylib::CommandBuffer",
+  .function = {
+    .dfree = command_buffer_free,
+    .dsize = command_buffer_memsize,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED,
+};
+
+static VALUE command_buffer_alloc(VALUE klass) {
+  command_buffer_t *buffer;
+
+  return TypedData_Make_Struct(klass, command_buffer_t, &command_buffer_type, buffer);
+}
+
+static command_buffer_t *get_command_buffer(VALUE self) {
+  command_buffer_t *buffer;
+  TypedData_Get_Struct(self, command_buffer_t, &command_buffer_type, buffer);
+
+  return buffer;
+}
+
+// Reserves a command of size bytes at the end of the arena, growing it when it's full
+static void *append(command_buffer_t *buffer, command_op op, size_t size) {
+  size = (size + COMMAND_ALIGN - 1) & ~(size_t) (COMMAND_ALIGN - 1);
+  if(size > UINT32_MAX) rb_raise(rb_eArgError, "command is too large");
+
+  if(size > buffer->capacity - buffer->length) {
+    size_t capacity = buffer->capacity ? buffer->capacity : COMMAND_BUFFER_CAPACITY;
+    while(size > capacity - buffer->length) {
+      if(capacity > SIZE_MAX / 2) rb_raise(rb_eNoMemError, "command buffer is too large");
+      capacity *= 2;
+    }
+
+    buffer->data = ruby_xrealloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+  }
+
+  command_header *header = (command_header *) (buffer->data + buffer->length);
+  header->op = op;
+  header->size = (uint32_t) size;
+  buffer->length += size;
+  buffer->commands++;
+
+  return header;
+}
+
+// Raylib::CommandBuffer.new(capacity = 4096), the initial size of the arena in bytes
+static VALUE command_buffer_initialize(int argc, VALUE *argv, VALUE self) {
+  VALUE capacityObj;
+  command_buffer_t *buffer = get_command_buffer(self);
+
+  rb_check_frozen(self);
+  rb_scan_args(argc, argv, "01", &capacityObj);
+  size_t capacity = NIL_P(capacityObj) ? COMMAND_BUFFER_CAPACITY : NUM2SIZET(capacityObj);
+  capacity = (capacity + COMMAND_ALIGN - 1) & ~(size_t) (COMMAND_ALIGN - 1);
+
+  if(capacity != buffer->capacity) {
+    buffer->data = ruby_xrealloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+  }
+  buffer->length = 0;
+  buffer->commands = 0;
+
+  return self;
+}
+
+static VALUE command_buffer_initialize_copy(VALUE self, VALUE other) {
+  command_buffer_t *buffer = get_command_buffer(self);
+  command_buffer_t *source = get_command_buffer(other);
+
+  rb_check_frozen(self);
+  if(buffer == source) return self;
+
+  buffer->data = ruby_xrealloc(buffer->data, source->capacity);
+  if(source->length) memcpy(buffer->data, source->data, source->length);
+  buffer->capacity = source->capacity;
+  buffer->length = source->length;
+  buffer->commands = source->commands;
+
+  return self;
+}
+
+// Raylib::CommandBuffer#clear_background(color), records Raylib.clear_background
+static VALUE command_buffer_clear_background(VALUE self, VALUE colorObj) {
+  command_buffer_t *buffer = get_command_buffer(self);
+  Color color = get_color(colorObj);
+
+  rb_check_frozen(self);
+  clear_background_command *command = append(buffer, COMMAND_CLEAR_BACKGROUND, sizeof(*command));
+  command->color = color;
+
+  return self;
+}
+
+// Raylib::CommandBuffer#draw_text(text, x, y, font_size, color), records Raylib.draw_text
+static VALUE command_buffer_draw_text(VALUE self, VALUE text, VALUE posX, VALUE posY, VALUE fontSize, VALUE colorObj) {
+  command_buffer_t *buffer = get_command_buffer(self);
+  const char *string = StringValueCStr(text);
+  size_t length = RSTRING_LEN(text);
+  int x = RB_FIX2INT(posX);
+  int y = RB_FIX2INT(posY);
+  int size = RB_FIX2INT(fontSize);
+  Color color = get_color(colorObj);
+
+  rb_check_frozen(self);
+  if(length > UINT32_MAX - sizeof(draw_text_command) - COMMAND_ALIGN) {
+    rb_raise(rb_eArgError, "text is too long");
+  }
+
+  draw_text_command *command = append(buffer, COMMAND_DRAW_TEXT, sizeof(*command) + length + 1);
+  command->color = color;
+  command->x = x;
+  command->y = y;
+  command->font_size = size;
+  memcpy(command->text, string, length + 1);
+
+  return self;
+}
+
+// Raylib::CommandBuffer#clear, removes the commands and keeps the arena for the next frame
+static VALUE command_buffer_clear(VALUE self) {
+  command_buffer_t *buffer = get_command_buffer(self);
+
+  rb_check_frozen(self);
+  buffer->length = 0;
+  buffer->commands = 0;
+
+  return self;
+}
+
+static VALUE command_buffer_size(VALUE self) {
+  return SIZET2NUM(get_command_buffer(self)->commands);
+}
+
+static VALUE command_buffer_bytesize(VALUE self) {
+  return SIZET2NUM(get_command_buffer(self)->length);
+}
+
+static VALUE command_buffer_capacity(VALUE self) {
+  return SIZET2NUM(get_command_buffer(self)->capacity);
+}
+
+// Runs the commands in the order they were recorded.
+// They were validated when they were appended, so it doesn't call into Ruby
+static void replay(const command_buffer_t *buffer) {
+  const unsigned char *command = buffer->data;
+  const unsigned char *end = buffer->data + buffer->length;
+
+  while(command < end) {
+    const command_header *header = (const command_header *) command;
+
+    switch((command_op) header->op) {
+      case COMMAND_CLEAR_BACKGROUND: {
+        const clear_background_command *clear = (const clear_background_command *) command;
+        ClearBackground(clear->color);
+        break;
+      }
+      case COMMAND_DRAW_TEXT: {
+        const draw_text_command *draw = (const draw_text_command *) command;
+        DrawText(draw->text, draw->x, draw->y, draw->font_size, draw->color);
+        break;
+      }
+    }
+
+    command += header->size;
+  }
+}
+
+bool command_buffer_replay(VALUE obj) {
+  if(!rb_typeddata_is_kind_of(obj, &command_buffer_type)) return false;
+
+  replay(get_command_buffer(obj));
+
+  return true;
+}
+
+// Raylib.submit(buffer), draws a frame with the commands of the buffer,
+// the same as calling them between Raylib.begin_drawing and Raylib.end_drawing.
+// The replay keeps the GVL, so other threads can't change the buffer meanwhile
+static VALUE submit(VALUE self, VALUE bufferObj) {
+  const command_buffer_t *buffer = get_command_buffer(bufferObj);
+
+  RAYLIB_PROBE2(submit__entry, buffer->commands, buffer->length);
+  BeginDrawing();
+  replay(buffer);
+  end_drawing_without_gvl();
+  RAYLIB_PROBE0(submit__return);
+
+  return Qnil;
+}
+
+VALUE init_command_buffer(VALUE super) {
+  VALUE commandBufferClass = rb_define_class_under(super, "CommandBuffer", rb_cObject);
+  rb_define_alloc_func(commandBufferClass, command_buffer_alloc);
+  rb_define_method(commandBufferClass, "initialize", command_buffer_initialize, -1);
+  rb_define_method(commandBufferClass, "initialize_copy", command_buffer_initialize_copy, 1);
+  rb_define_method(commandBufferClass, "clear_background", command_buffer_clear_background, 1);
+  rb_define_method(commandBufferClass, "draw_text", command_buffer_draw_text, 5);
+  rb_define_method(commandBufferClass, "clear", command_buffer_clear, 0);
+  rb_define_method(commandBufferClass, "size", command_buffer_size, 0);
+  rb_define_method(commandBufferClass, "bytesize", command_buffer_bytesize, 0);
+  rb_define_method(commandBufferClass, "capacity", command_buffer_capacity, 0);
+
+  rb_define_singleton_method(super, "submit", submit, 1);
+
+  return commandBufferClass;
+}
@@ -0,0 +1,12 @@
+#ifndef RAYLIB_COMMAND_BUFFER_H
+#define RAYLIB_COMMAND_BUFFER_H
+
+#include "color.h"
+
+// Defines Raylib::CommandBuffer and Raylib.submit
+VALUE init_command_buffer(VALUE super);
+// Replays the commands of obj when it's a Raylib::CommandBuffer,
+// returns whether it was one
+bool command_buffer_replay(VALUE obj);
+
+#endif
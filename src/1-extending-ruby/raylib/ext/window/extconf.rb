@@ -2,5 +2,42 @@ require 'mkmf'
 
 append_ldflags %w[-lraylib -lGL -lm -lpthread -ldl -lrt -lX11]
 have_header 'raylib.h'
+# USDT probes, see ext/window/probes.h, `ruby extconf.rb --disable-probes` compiles them out
+have_header 'sys/sdt.h' if enable_config('probes', true)
 
-create_makefile 'window/window'
+# Tuned builds, e.g. `ruby extconf.rb --with-pgo --with-lto --with-march=native`.
+# The flags are checked here, so an unsupported compiler fails now instead of in make
+def check_tuning_flags(option, *flags)
+  flags.each do |flag|
+    next if checking_for("whether #{flag} is accepted as CFLAGS") { try_cflags(flag) }
+
+    abort "--with-#{option} needs #{flag}, which #{RbConfig::CONFIG['CC']} doesn't support"
+  end
+  flags.join(' ')
+end
+
+if (march = with_config('march'))
+  abort '--with-march needs a value, e.g. --with-march=native' if march == true
+  $CFLAGS << ' ' << check_tuning_flags('march', "-march=#{march}")
+end
+
+if with_config('lto')
+  lto = check_tuning_flags('lto', try_cflags('-flto=auto') ? '-flto=auto' : '-flto')
+  $CFLAGS << ' ' << lto
+  $LDFLAGS << ' ' << lto
+end
+
+# The profile is collected by make, see ext/window/depend.
+# Only GCC's flags are supported, clang needs llvm-profdata to merge its profiles
+pgo = with_config('pgo')
+if pgo
+  check_tuning_flags 'pgo', '-fprofile-generate', '-fprofile-partial-training'
+  $CFLAGS << ' $(PGO_CFLAGS)'
+  $LDFLAGS << ' $(PGO_CFLAGS)'
+  $distcleanfiles << 'pgo-profile/*.gcda' << 'pgo-profile/.trained'
+  $distcleandirs << 'pgo-profile'
+end
+
+create_makefile 'window/window' do |conf|
+  conf << "PGO = #{pgo ? 'use' : ''}\n"
+end
@@ -0,0 +1,95 @@
+#include <math.h>
+#include "color.h"
+#include "command_buffer.h"
+#include "window.h"
+
+typedef struct {
+  VALUE update;
+  VALUE draw;
+  double step;
+  int max_steps;
+  double alpha;
+} game_loop_t;
+
+static ID idCall;
+static ID loopIds[4];
+
+static VALUE draw_frame(VALUE data) {
+  game_loop_t *loop = (game_loop_t *) data;
+
+  command_buffer_replay(rb_funcall(loop->draw, idCall, 1, DBL2NUM(loop->alpha)));
+
+  return Qnil;
+}
+
+// Called even when draw raises, so raylib isn't left in the middle of a frame
+static VALUE end_frame(VALUE data) {
+  end_drawing_without_gvl();
+
+  return Qnil;
+}
+
+// Raylib.run(update:, draw:, hz: 60, max_steps: 5)
+// Runs the game loop in C until the window should close, calling into Ruby
+// only for the hooks: update.call(dt) advances the game by a fixed step of
+// 1 / hz seconds, as many times as the elapsed time allows, and then
+// draw.call(alpha) draws a frame between BeginDrawing and EndDrawing.
+// alpha, between 0 and 1, is how far the time is into the next step,
+// so draw can interpolate between the last two states.
+// When draw returns a Raylib::CommandBuffer, its commands are replayed.
+//
+// When the updates can't keep up, at most max_steps of them run per frame
+// and the time left behind is dropped, so the game slows down instead of
+// spending every frame catching up.
+// The frames are paced by Raylib.set_target_fps, EndDrawing waits without the GVL
+static VALUE run(int argc, VALUE *argv, VALUE self) {
+  VALUE opts, values[4];
+  game_loop_t loop;
+
+  rb_scan_args(argc, argv, ":", &opts);
+  rb_get_kwargs(opts, loopIds, 2, 2, values);
+
+  double hz = values[2] == Qundef ? 60.0 : NUM2DBL(values[2]);
+  if(!(hz > 0.0 && isfinite(hz))) rb_raise(rb_eArgError, "hz must be positive");
+
+  loop.max_steps = values[3] == Qundef ? 5 : NUM2INT(values[3]);
+  if(loop.max_steps < 1) rb_raise(rb_eArgError, "max_steps must be at least 1");
+
+  loop.update = values[0];
+  loop.draw = values[1];
+  loop.step = 1.0 / hz;
+
+  double accumulator = 0.0;
+  double previous = GetTime();
+
+  while(!window_should_close_without_gvl()) {
+    double now = GetTime();
+    accumulator += now - previous;
+    previous = now;
+
+    for(int steps = 0; accumulator >= loop.step && steps < loop.max_steps; ++steps) {
+      rb_funcall(loop.update, idCall, 1, DBL2NUM(loop.step));
+      accumulator -= loop.step;
+    }
+    // Overloaded, only the fraction of a step is kept
+    if(accumulator >= loop.step) accumulator = fmod(accumulator, loop.step);
+
+    loop.alpha = accumulator / loop.step;
+    BeginDrawing();
+    rb_ensure(draw_frame, (VALUE) &loop, end_frame, Qnil);
+  }
+
+  return Qnil;
+}
+
+VALUE init_loop(VALUE super) {
+  idCall = rb_intern("call");
+  loopIds[0] = rb_intern("update");
+  loopIds[1] = rb_intern("draw");
+  loopIds[2] = rb_intern("hz");
+  loopIds[3] = rb_intern("max_steps");
+
+  rb_define_singleton_method(super, "run", run, -1);
+
+  return super;
+}
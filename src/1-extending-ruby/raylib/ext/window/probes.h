@@ -0,0 +1,30 @@
+#ifndef RAYLIB_PROBES_H
+#define RAYLIB_PROBES_H
+
+// USDT probes, for perf, bpftrace or systemtap, e.g. the time spent in each frame's end_drawing:
+//   bpftrace -e 'usdt:./window.so:raylib:end_drawing__entry { @start[tid] = nsecs; }
+//                usdt:./window.so:raylib:end_drawing__return /@start[tid]/ { @ns = hist(nsecs - @start[tid]); }'
+// A probe is a single nop until a tracer attaches to it, which then reads the arguments
+// from where the compiler left them. They need sys/sdt.h (systemtap-sdt-dev),
+// otherwise or with `ruby extconf.rb --disable-probes` they're compiled out.
+//
+// Every drawing method has an entry and a return probe, the entry ones carry the arguments:
+//   begin_drawing__entry()
+//   end_drawing__entry()                      it waits for the next frame when there's a target FPS
+//   clear_background__entry(rgba)             the color packed as 0xRRGGBBAA
+//   draw_text__entry(length, x, y, font_size) length of the text in bytes
+//   submit__entry(commands, bytes)            a Raylib::CommandBuffer is replayed as a frame
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define RAYLIB_PROBE0(name) DTRACE_PROBE(raylib, name)
+#define RAYLIB_PROBE1(name, a) DTRACE_PROBE1(raylib, name, a)
+#define RAYLIB_PROBE2(name, a, b) DTRACE_PROBE2(raylib, name, a, b)
+#define RAYLIB_PROBE4(name, a, b, c, d) DTRACE_PROBE4(raylib, name, a, b, c, d)
+#else
+#define RAYLIB_PROBE0(name) ((void) 0)
+#define RAYLIB_PROBE1(name, a) ((void) 0)
+#define RAYLIB_PROBE2(name, a, b) ((void) 0)
+#define RAYLIB_PROBE4(name, a, b, c, d) ((void) 0)
+#endif
+
+#endif
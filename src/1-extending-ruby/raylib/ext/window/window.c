@@ -1,7 +1,39 @@
 #include "color.h"
+#include "command_buffer.h"
+#include "probes.h"
+#include "window.h"
+#include <ruby/thread.h>
 // color.h already includes ruby.h and raylib.h,
 // so there is no need for include them here too
 
+// EndDrawing swaps the buffers and sleeps until the next frame when there's
+// a target FPS, and WindowShouldClose waits for events while the window
+// is minimized. They run without the GVL, so other Ruby threads get that time.
+// Other threads must not call Raylib meanwhile, the OpenGL context belongs to this one.
+// There's no way to wake them up early, so an interrupt waits for them to return
+static void *end_drawing_call(void *data) {
+  EndDrawing();
+
+  return NULL;
+}
+
+static void *window_should_close_call(void *data) {
+  *(bool *) data = WindowShouldClose();
+
+  return NULL;
+}
+
+void end_drawing_without_gvl(void) {
+  rb_thread_call_without_gvl(end_drawing_call, NULL, NULL, NULL);
+}
+
+bool window_should_close_without_gvl(void) {
+  bool close;
+  rb_thread_call_without_gvl(window_should_close_call, &close, NULL, NULL);
+
+  return close;
+}
+
 static VALUE init_window(VALUE self, VALUE height, VALUE width, VALUE title) {
   InitWindow(
     RB_FIX2INT(height),
@@ -19,35 +51,47 @@ static VALUE set_target_fps(VALUE self, VALUE fps) {
 }
 
 static VALUE window_should_close(VALUE self) {
-  return WindowShouldClose();
+  return window_should_close_without_gvl() ? Qtrue : Qfalse;
 }
 
 static VALUE begin_drawing(VALUE self) {
+  RAYLIB_PROBE0(begin_drawing__entry);
   BeginDrawing();
+  RAYLIB_PROBE0(begin_drawing__return);
 
   return Qnil;
 }
 
 static VALUE end_drawing(VALUE self) {
-  EndDrawing();
+  RAYLIB_PROBE0(end_drawing__entry);
+  end_drawing_without_gvl();
+  RAYLIB_PROBE0(end_drawing__return);
 
   return Qnil;
 }
 
 static VALUE clear_background(VALUE self, VALUE colorObj) {
-  ClearBackground(get_color(colorObj));
+  Color color = get_color(colorObj);
+
+  RAYLIB_PROBE1(clear_background__entry, (uint32_t) color.r << 24 | color.g << 16 | color.b << 8 | color.a);
+  ClearBackground(color);
+  RAYLIB_PROBE0(clear_background__return);
 
   return Qnil;
 }
 
 static VALUE draw_text(VALUE self, VALUE text, VALUE posX, VALUE posY, VALUE fontSize, VALUE colorObj) {
+  const char *string = StringValueCStr(text);
+
+  RAYLIB_PROBE4(draw_text__entry, RSTRING_LEN(text), RB_FIX2INT(posX), RB_FIX2INT(posY), RB_FIX2INT(fontSize));
   DrawText(
-    StringValueCStr(text),
+    string,
     RB_FIX2INT(posX),
     RB_FIX2INT(posY),
     RB_FIX2INT(fontSize),
     get_color(colorObj)
   );
+  RAYLIB_PROBE0(draw_text__return);
 
   return Qnil;
 }
@@ -72,4 +116,8 @@ void Init_window(void) {
 
   // Creating a Raylib::Color Class
   init_color(raylibModule);
+  // Creating a Raylib::CommandBuffer Class and Raylib.submit
+  init_command_buffer(raylibModule);
+  // Defining Raylib.run, the game loop
+  init_loop(raylibModule);
 }
@@ -0,0 +1,14 @@
+#ifndef RAYLIB_WINDOW_H
+#define RAYLIB_WINDOW_H
+
+#include <stdbool.h>
+#include <ruby.h>
+
+// Call EndDrawing and WindowShouldClose without the GVL, see window.c
+void end_drawing_without_gvl(void);
+bool window_should_close_without_gvl(void);
+
+// Defines Raylib.run, the fixed timestep loop
+VALUE init_loop(VALUE super);
+
+#endif
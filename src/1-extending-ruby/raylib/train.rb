@@ -0,0 +1,32 @@
+#!/usr/bin/env ruby
+
+# Training workload of the profile guided build (`ruby ./ext/window/extconf.rb --with-pgo`),
+# it draws a fixed number of frames as fast as it can.
+# Without a display, it runs itself again under xvfb-run
+
+require 'rbconfig'
+
+if ENV['DISPLAY'].to_s.empty? && ENV['WAYLAND_DISPLAY'].to_s.empty?
+  begin
+    exec 'xvfb-run', '-a', RbConfig.ruby, __FILE__, *ARGV
+  rescue Errno::ENOENT
+    abort 'There is no display to train on, set DISPLAY or install xvfb-run'
+  end
+end
+
+require_relative 'window.so'
+
+FRAMES = Integer(ARGV.first || 600)
+
+Raylib.init_window 800, 450, 'raylib [core] example - training'
+# Without a target the frames aren't throttled
+Raylib.set_target_fps 0
+
+FRAMES.times do |frame|
+  Raylib.begin_drawing
+  Raylib.clear_background Raylib::RAYWHITE
+  Raylib.draw_text "Frame #{frame} of #{FRAMES}", 190, 200, 20, Raylib::LIGHTGRAY
+  Raylib.end_drawing
+end
+
+Raylib.close_window
@@ -1,28 +1,97 @@
 const std = @import("std");
+const builtin = @import("builtin");
 const posix = std.posix;
 const InotifyEvent = std.os.linux.inotify_event;
 const inotify = @cImport(@cInclude("sys/inotify.h"));
 
 const Callback = *const fn (event: *InotifyEvent, name: [*:0]const u8) callconv(.C) void;
 
+// USDT probes for perf, bpftrace or systemtap, e.g. the latency of each call:
+//   bpftrace -e 'usdt:./lib/libinotify.so:inotify:watch__entry { @start[tid] = nsecs; }
+//                usdt:./lib/libinotify.so:inotify:watch__return /@start[tid]/ { @ns = hist(nsecs - @start[tid]); }'
+// sys/sdt.h is made of C macros with inline assembly, which @cImport can't translate,
+// so probe emits the same nop and .note.stapsdt entry. A probe is only that nop
+// until a tracer attaches to it, which then reads the arguments from the registers.
+// The arguments are written for x86_64, elsewhere the probes are compiled out.
+//
+//   watch__entry(fd)
+//   event(wd, mask, cookie, len)       each event, before calling the callback
+//   watch__return(fd, events, result)
+const probes_enabled = builtin.cpu.arch == .x86_64 and builtin.os.tag == .linux;
+
+// Same layout as the STAP_PROBE macros of sys/sdt.h, every argument is a signed 64 bit register
+fn probeNote(comptime name: []const u8, comptime argc: usize) []const u8 {
+    const operands = [_][]const u8{ "%[a]", "%[b]", "%[c]", "%[d]" };
+    comptime var args: []const u8 = "";
+    inline for (operands[0..argc], 0..) |operand, i| {
+        args = args ++ (if (i > 0) " " else "") ++ "-8@" ++ operand;
+    }
+
+    return "990: nop\n" ++
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" ++
+        ".balign 4\n" ++
+        ".4byte 992f-991f, 994f-993f, 3\n" ++
+        "991: .asciz \"stapsdt\"\n" ++
+        "992: .balign 4\n" ++
+        "993: .8byte 990b\n" ++
+        ".8byte _.stapsdt.base\n" ++
+        ".8byte 0\n" ++
+        ".asciz \"inotify\"\n" ++
+        ".asciz \"" ++ name ++ "\"\n" ++
+        ".asciz \"" ++ args ++ "\"\n" ++
+        "994: .balign 4\n" ++
+        ".popsection\n" ++
+        ".ifndef _.stapsdt.base\n" ++
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" ++
+        ".weak _.stapsdt.base\n" ++
+        ".hidden _.stapsdt.base\n" ++
+        "_.stapsdt.base: .space 1\n" ++
+        ".size _.stapsdt.base, 1\n" ++
+        ".popsection\n" ++
+        ".endif\n";
+}
+
+inline fn probe(comptime name: []const u8, args: anytype) void {
+    if (!probes_enabled) return;
+
+    var values = [4]i64{ 0, 0, 0, 0 };
+    inline for (args, 0..) |arg, i| values[i] = @intCast(arg);
+
+    asm volatile (comptime probeNote(name, args.len)
+        :
+        : [a] "r" (values[0]),
+          [b] "r" (values[1]),
+          [c] "r" (values[2]),
+          [d] "r" (values[3]),
+    );
+}
+
 export fn watch(fd: i32, cb: Callback) callconv(.C) i32 {
     var buff: [@sizeOf(InotifyEvent) + posix.PATH_MAX:0]u8 align(@alignOf(InotifyEvent)) = undefined;
     var read: usize = undefined;
     var idx: usize = 0;
     var event: *InotifyEvent = undefined;
+    var events: usize = 0;
+
+    probe("watch__entry", .{fd});
 
     read = posix.read(fd, &buff) catch |err| {
-        return switch (err) {
+        const result: i32 = switch (err) {
             error.WouldBlock => -1,
             else => @intFromError(err),
         };
+        probe("watch__return", .{ fd, events, result });
+        return result;
     };
 
     while (idx < read) {
         event = @ptrCast(@alignCast(buff[idx..read]));
         idx += @sizeOf(InotifyEvent) + event.len;
         const name = event.getName() orelse "";
+        probe("event", .{ event.wd, event.mask, event.cookie, event.len });
         cb(event, name);
+        events += 1;
     }
+    probe("watch__return", .{ fd, events, 0 });
     return 0;
 }